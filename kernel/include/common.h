@@ -4,6 +4,7 @@
 /* Uncomment these macros to enable corresponding functionality. */
 //#define IA32_SEG
 //#define IA32_PAGE
+//#define IA32_LARGE_PAGE	/* map the kernel with 4MB pages, needs IA32_PAGE */
 //#define IA32_INTR
 //#define HAS_DEVICE
 
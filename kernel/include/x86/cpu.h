@@ -24,6 +24,20 @@ write_cr3(uint32_t cr3) {
 	asm volatile("movl %0, %%cr3" : : "r"(cr3));
 }
 
+/* read CR4 */
+static inline uint32_t
+read_cr4() {
+	uint32_t val;
+	asm volatile("movl %%cr4, %0" : "=r"(val));
+	return val;
+}
+
+/* write CR4 */
+static inline void
+write_cr4(uint32_t cr4) {
+	asm volatile("movl %0, %%cr4" : : "r"(cr4));
+}
+
 /* modify the value of GDTR */
 static inline void
 write_gdtr(void *addr, uint32_t size) {
@@ -4,7 +4,9 @@
 #include <string.h>
 
 static PDE kpdir[NR_PDE] align_to_page;						// kernel page directory
+#ifndef IA32_LARGE_PAGE
 static PTE kptable[PHY_MEM / PAGE_SIZE] align_to_page;		// kernel page tables
+#endif
 
 PDE* get_kpdir() { return kpdir; }
 
@@ -13,12 +15,31 @@ void init_page(void) {
 	CR0 cr0;
 	CR3 cr3;
 	PDE *pdir = (PDE *)va_to_pa(kpdir);
-	PTE *ptable = (PTE *)va_to_pa(kptable);
 	uint32_t pdir_idx;
 
 	/* make all PDEs invalid */
 	memset(pdir, 0, NR_PDE * sizeof(PDE));
 
+#ifdef IA32_LARGE_PAGE
+	/* Map the physical memory with 4MB pages. No page tables are needed.
+	 * The kernel mapping is the same in all address spaces, so it is made
+	 * global to stay in the TLB when CR3 is written. The identity mapping
+	 * is only used by the kernel, and is not global.
+	 */
+	for (pdir_idx = 0; pdir_idx < PHY_MEM / PT_SIZE; pdir_idx ++) {
+		pdir[pdir_idx].val = make_large_pde(pdir_idx * PT_SIZE);
+		pdir[pdir_idx + KOFFSET / PT_SIZE].val = make_large_pde(pdir_idx * PT_SIZE) | PDE_GLOBAL;
+	}
+
+	/* set PSE bit in CR4 to enable 4MB pages, and PGE bit to enable global pages */
+	CR4 cr4;
+	cr4.val = read_cr4();
+	cr4.page_size_extensions = 1;
+	cr4.page_global_enable = 1;
+	write_cr4(cr4.val);
+#else
+	PTE *ptable = (PTE *)va_to_pa(kptable);
+
 	/* fill PDEs */
 	for (pdir_idx = 0; pdir_idx < PHY_MEM / PT_SIZE; pdir_idx ++) {
 		pdir[pdir_idx].val = make_pde(ptable);
@@ -53,6 +74,7 @@ void init_page(void) {
 			ptable --;
 		}
 	*/
+#endif
 
 
 	/* make CR3 to be the entry of page directory */
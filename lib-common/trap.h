@@ -4,13 +4,28 @@
 #define concat_temp(x, y) x ## y
 #define concat(x, y) concat_temp(x, y)
 
+/* The hypercall interface between the guest and NEMU.
+ * The guest puts the hypercall number in %eax, the arguments in %ebx
+ * and %ecx, and then executes the trap instruction (0xd6). The result
+ * is returned in %edx:%eax.
+ */
+#define NEMU_HC_GOOD_TRAP		0
+#define NEMU_HC_BAD_TRAP		1
+#define NEMU_HC_NOP				2		/* reserved, do nothing */
+#define NEMU_HC_INSTR_CNT		0x10	/* number of instructions retired */
+#define NEMU_HC_HOST_TIME		0x11	/* host monotonic time in nanoseconds */
+#define NEMU_HC_REGION_BEGIN	0x12	/* %ebx = address of the region name */
+#define NEMU_HC_REGION_END		0x13	/* end the innermost region */
+#define NEMU_HC_DUMP_STATS		0x14	/* print the region statistics */
+#define NEMU_HC_GET_INPUT		0x15	/* %ebx = buffer, %ecx = its size, return the input length */
+
 #ifndef __ASSEMBLER__
 
 #define HIT_GOOD_TRAP \
-	asm volatile(".byte 0xd6" : : "a" (0))
+	asm volatile(".byte 0xd6" : : "a" (NEMU_HC_GOOD_TRAP))
 
 #define HIT_BAD_TRAP \
-	asm volatile(".byte 0xd6" : : "a" (1))
+	asm volatile(".byte 0xd6" : : "a" (NEMU_HC_BAD_TRAP))
 
 #define nemu_assert(cond) \
 	do { \
@@ -22,14 +37,29 @@ set_bp(void) {
 	asm volatile ("int3");
 }
 
+static __attribute__((always_inline)) inline unsigned long long
+nemu_hypercall(unsigned int no, unsigned int arg0, unsigned int arg1) {
+	unsigned int lo, hi;
+	asm volatile (".byte 0xd6" : "=a" (lo), "=d" (hi) : "0" (no), "b" (arg0), "c" (arg1) : "memory");
+	return ((unsigned long long)hi << 32) | lo;
+}
+
+#define nemu_instr_cnt() nemu_hypercall(NEMU_HC_INSTR_CNT, 0, 0)
+#define nemu_host_time() nemu_hypercall(NEMU_HC_HOST_TIME, 0, 0)
+#define nemu_region_begin(name) nemu_hypercall(NEMU_HC_REGION_BEGIN, (unsigned int)(name), 0)
+#define nemu_region_end() nemu_hypercall(NEMU_HC_REGION_END, 0, 0)
+#define nemu_dump_stats() nemu_hypercall(NEMU_HC_DUMP_STATS, 0, 0)
+#define nemu_get_input(buf, size) \
+	((unsigned int)nemu_hypercall(NEMU_HC_GET_INPUT, (unsigned int)(buf), (size)))
+
 #else
 
 #define HIT_GOOD_TRAP \
-	movl $0, %eax; \
+	movl $NEMU_HC_GOOD_TRAP, %eax; \
 	.byte 0xd6
 
 #define HIT_BAD_TRAP \
-	movl $1, %eax; \
+	movl $NEMU_HC_BAD_TRAP, %eax; \
 	.byte 0xd6
 
 #define nemu_assert(reg, val) \
@@ -46,7 +46,10 @@ typedef union PageDirectoryEntry {
 		uint32_t page_write_through  : 1;
 		uint32_t page_cache_disable  : 1;
 		uint32_t accessed            : 1;
-		uint32_t pad0                : 6;
+		uint32_t dirty               : 1;	// only for 4MB pages
+		uint32_t page_size           : 1;	// 4MB page if CR4.PSE is set
+		uint32_t global              : 1;	// only for 4MB pages
+		uint32_t pad0                : 3;
 		uint32_t page_frame          : 20;
 	};
 	uint32_t val;
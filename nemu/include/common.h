@@ -9,6 +9,11 @@
 #define DEBUG
 #define LOG_FILE
 
+/* Count the instructions retired and the host cycles spent for each opcode.
+ * The statistics are reported at exit and by the `opstat' command.
+ */
+//#define OPCODE_STAT
+
 #include "debug.h"
 #include "macro.h"
 
@@ -54,4 +54,7 @@ void write_operand_b(Operand *, uint8_t);
 void write_operand_w(Operand *, uint16_t);
 void write_operand_l(Operand *, uint32_t);
 
+const char* operand_str(Operand *);
+const char* get_asm();
+
 #endif
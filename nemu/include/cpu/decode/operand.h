@@ -15,13 +15,29 @@ typedef struct {
 		int32_t simm;
 	};
 	uint32_t val;
-	char str[OP_STR_SIZE];
+
+	/* The addressing mode of a memory operand. It is only used to
+	 * generate the assembly code on demand.
+	 */
+	struct {
+		int8_t base, index;		/* -1 if not used */
+		uint8_t scale;
+		uint8_t disp_size;		/* 0 if there is no displacement */
+		int32_t disp;
+	} mem;
 } Operand;
 
 typedef struct {
 	uint32_t opcode;
 	bool is_operand_size_16;
+	bool seg_override;		/* whether `current_sreg' is set by a prefix */
 	Operand src, dest, src2;
+
+	/* Recorded by print_asm_template*(). If `asm_name' is NULL, the
+	 * assembly code has already been written into `assembly'.
+	 */
+	const char *asm_name;
+	int asm_nr_op;
 } Operands;
 
 #endif
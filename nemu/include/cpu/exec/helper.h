@@ -3,6 +3,7 @@
 
 #include "cpu/helper.h"
 #include "cpu/decode/decode.h"
+#include "cpu/decode/modrm.h"
 
 #define make_helper_v(name) \
 	make_helper(concat(name, _v)) { \
@@ -16,20 +17,93 @@
 		return idex(eip, concat4(decode_, type, _, SUFFIX), do_execute); \
 	}
 
-extern char assembly[];
+#define do_op concat4(op_, instr, _, SUFFIX)
+
+/* Handlers of the r2rm, rm2r and i2rm forms for an instruction which
+ * computes `dest = do_op(dest, src)'. The template defines do_op() before
+ * using this. Unlike make_instr_helper(), the operands are not decoded
+ * into `ops_decoded': the register form reads and writes the registers
+ * directly, and the memory form only uses load_addr() for the address.
+ * `reads_dest' is 0 if do_op() ignores the old value of the destination,
+ * so that it is not read from the memory.
+ */
+#define make_form_helpers(reads_dest) \
+	make_helper(concat5(instr, _, r2rm, _, SUFFIX)) { \
+		ModR_M m; \
+		m.val = instr_fetch(eip + 1, 1); \
+		if(m.mod == 3) { \
+			REG(m.R_M) = do_op(REG(m.R_M), REG(m.reg)); \
+			print_asm(str(instr) str(SUFFIX) " %%%s,%%%s", REG_NAME(m.reg), REG_NAME(m.R_M)); \
+			return 2; \
+		} \
+		Operand rm; \
+		rm.size = DATA_BYTE; \
+		int len = load_addr(eip + 1, &m, &rm); \
+		MEM_W(rm.addr, do_op((reads_dest ? MEM_R(rm.addr) : 0), REG(m.reg))); \
+		print_asm(str(instr) str(SUFFIX) " %%%s,%s", REG_NAME(m.reg), operand_str(&rm)); \
+		return 1 + len; \
+	} \
+	\
+	make_helper(concat5(instr, _, rm2r, _, SUFFIX)) { \
+		ModR_M m; \
+		m.val = instr_fetch(eip + 1, 1); \
+		if(m.mod == 3) { \
+			REG(m.reg) = do_op(REG(m.reg), REG(m.R_M)); \
+			print_asm(str(instr) str(SUFFIX) " %%%s,%%%s", REG_NAME(m.R_M), REG_NAME(m.reg)); \
+			return 2; \
+		} \
+		Operand rm; \
+		rm.size = DATA_BYTE; \
+		int len = load_addr(eip + 1, &m, &rm); \
+		REG(m.reg) = do_op(REG(m.reg), MEM_R(rm.addr)); \
+		print_asm(str(instr) str(SUFFIX) " %s,%%%s", operand_str(&rm), REG_NAME(m.reg)); \
+		return 1 + len; \
+	} \
+	\
+	make_helper(concat5(instr, _, i2rm, _, SUFFIX)) { \
+		ModR_M m; \
+		m.val = instr_fetch(eip + 1, 1); \
+		if(m.mod == 3) { \
+			DATA_TYPE imm = instr_fetch(eip + 2, DATA_BYTE); \
+			REG(m.R_M) = do_op(REG(m.R_M), imm); \
+			print_asm(str(instr) str(SUFFIX) " $0x%x,%%%s", imm, REG_NAME(m.R_M)); \
+			return 2 + DATA_BYTE; \
+		} \
+		Operand rm; \
+		rm.size = DATA_BYTE; \
+		int len = load_addr(eip + 1, &m, &rm); \
+		DATA_TYPE imm = instr_fetch(eip + 1 + len, DATA_BYTE); \
+		MEM_W(rm.addr, do_op((reads_dest ? MEM_R(rm.addr) : 0), imm)); \
+		print_asm(str(instr) str(SUFFIX) " $0x%x,%s", imm, operand_str(&rm)); \
+		return 1 + len + DATA_BYTE; \
+	}
+
+extern __thread char assembly[];
 #ifdef DEBUG
-#define print_asm(...) Assert(snprintf(assembly, 80, __VA_ARGS__) < 80, "buffer overflow!")
+/* Set by cpu_exec() if the assembly code of the instruction will be printed. */
+extern __thread bool asm_requested;
+
+/* The arguments are only evaluated when the assembly code is requested. */
+#define print_asm(...) \
+	do { \
+		ops_decoded.asm_name = NULL; \
+		if(asm_requested) { \
+			Assert(snprintf(assembly, 80, __VA_ARGS__) < 80, "buffer overflow!"); \
+		} \
+	} while(0)
+
+/* Only record the mnemonic here. The assembly code is generated
+ * from `ops_decoded' by get_asm() when someone asks for it.
+ */
+#define print_asm_template(n) \
+	(ops_decoded.asm_name = str(instr) str(SUFFIX), ops_decoded.asm_nr_op = n)
 #else
 #define print_asm(...)
+#define print_asm_template(n)
 #endif
 
-#define print_asm_template1() \
-	print_asm(str(instr) str(SUFFIX) " %s", op_src->str)
-
-#define print_asm_template2() \
-	print_asm(str(instr) str(SUFFIX) " %s,%s", op_src->str, op_dest->str)
-
-#define print_asm_template3() \
-	print_asm(str(instr) str(SUFFIX) " %s,%s,%s", op_src->str, op_src2->str, op_dest->str)
+#define print_asm_template1() print_asm_template(1)
+#define print_asm_template2() print_asm_template(2)
+#define print_asm_template3() print_asm_template(3)
 
 #endif
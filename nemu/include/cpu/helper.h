@@ -8,7 +8,13 @@
 #define make_helper(name) int name(swaddr_t eip)
 
 static inline uint32_t instr_fetch(swaddr_t addr, size_t len) {
-	return swaddr_read(addr, len);
+	FetchWindow *w = &fetch_window;
+	if(addr >= w->start && addr + len <= w->end) {
+		uint32_t val = 0;
+		memcpy(&val, w->host + (addr - w->start), len);
+		return val;
+	}
+	return instr_fetch_refill(addr, len);
 }
 
 /* Instruction Decode and EXecute */
@@ -20,7 +26,7 @@ static inline int idex(swaddr_t eip, int (*decode)(swaddr_t), void (*execute) (v
 }
 
 /* shared by all helper function */
-extern Operands ops_decoded;
+extern __thread Operands ops_decoded;
 
 #define op_src (&ops_decoded.src)
 #define op_src2 (&ops_decoded.src2)
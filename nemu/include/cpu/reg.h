@@ -2,10 +2,22 @@
 #define __REG_H__
 
 #include "common.h"
+#include "../../lib-common/x86-inc/cpu.h"
 
 enum { R_EAX, R_ECX, R_EDX, R_EBX, R_ESP, R_EBP, R_ESI, R_EDI };
 enum { R_AX, R_CX, R_DX, R_BX, R_SP, R_BP, R_SI, R_DI };
 enum { R_AL, R_CL, R_DL, R_BL, R_AH, R_CH, R_DH, R_BH };
+enum { R_ES, R_CS, R_SS, R_DS, R_FS, R_GS };
+
+/* A segment register, with the descriptor cache hidden from the program.
+ * The cache is loaded only when the register is written.
+ */
+typedef struct {
+	uint16_t selector;
+	uint32_t base, limit;
+	uint8_t type, dpl;
+	bool flat;		/* base 0 and limit 4GB, so no translation is needed */
+} SegReg;
 
 /* TODO: Re-organize the `CPU_state' structure to match the register
  * encoding scheme in i386 instruction format. For example, if we
@@ -27,9 +39,19 @@ typedef struct {
 
 	swaddr_t eip;
 
+	SegReg sreg[6];
+	struct {
+		uint32_t base;
+		uint16_t limit;
+	} gdtr;
+
+	CR0 cr0;
+	CR3 cr3;
+	CR4 cr4;
+
 } CPU_state;
 
-extern CPU_state cpu;
+extern __thread CPU_state cpu;
 
 static inline int check_reg_index(int index) {
 	assert(index >= 0 && index < 8);
@@ -43,5 +65,12 @@ static inline int check_reg_index(int index) {
 extern const char* regsl[];
 extern const char* regsw[];
 extern const char* regsb[];
+extern const char* sregs[];
+
+/* Load the segment register and its descriptor cache. */
+void load_sreg(int, uint16_t);
+
+/* Reset the segment registers to flat segments. */
+void reset_sregs();
 
 #endif
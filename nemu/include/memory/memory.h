@@ -5,7 +5,18 @@
 
 #define HW_MEM_SIZE (128 * 1024 * 1024)
 
-extern uint8_t *hw_mem;
+extern __thread uint8_t *hw_mem;
+
+/* how the memory of the machines is backed by the host */
+enum { DRAM_SMALL_PAGES, DRAM_THP, DRAM_HUGETLB };
+extern int dram_page_mode;
+
+void* new_dram();
+void free_dram(void *);
+void init_dram(void *);
+void invalidate_rowbufs();
+size_t dram_resident();
+bool dram_used_pages(uint8_t *);
 
 /* convert the hardware address in the test program to virtual address in NEMU */
 #define hwa_to_va(p) ((void *)(hw_mem + (unsigned)p))
@@ -17,6 +28,43 @@ extern uint8_t *hw_mem;
 	hwa_to_va(addr); \
 })
 
+/* the segment register used by swaddr_read() and swaddr_write(), DS
+ * unless the instruction being executed says otherwise
+ */
+extern __thread uint8_t current_sreg;
+
+/* The rest of the code page being executed, read by instr_fetch()
+ * directly from the host memory. It is flushed when the code in it is
+ * written, or when the translation of the code segment may change.
+ */
+typedef struct {
+	swaddr_t start, end;		/* [start, end) in the code segment */
+	const uint8_t *host;		/* the host address of `start' */
+	hwaddr_t hw_start, hw_end;	/* the physical range, empty if flushed */
+} FetchWindow;
+
+extern __thread FetchWindow fetch_window;
+
+static inline void fetch_window_flush() {
+	fetch_window.start = fetch_window.end = 0;
+	fetch_window.hw_start = fetch_window.hw_end = 0;
+}
+
+/* One bit for each physical page, set if instructions have been fetched
+ * from it. hwaddr_write() checks it, so that only the writes to such
+ * pages look for the cached code to invalidate. The bit of the page under
+ * the fetch window is always set.
+ */
+extern __thread uint8_t code_page_map[];
+
+#define CODE_PAGE_SHIFT 12
+#define code_page_set(addr) \
+	((code_page_map[((addr) & (HW_MEM_SIZE - 1)) >> (CODE_PAGE_SHIFT + 3)] >> (((addr) >> CODE_PAGE_SHIFT) & 0x7)) & 1)
+
+void code_page_write(hwaddr_t, size_t);
+
+uint32_t instr_fetch_refill(swaddr_t, size_t);
+uint32_t instr_read(swaddr_t, size_t);
 uint32_t swaddr_read(swaddr_t, size_t);
 uint32_t lnaddr_read(lnaddr_t, size_t);
 uint32_t hwaddr_read(hwaddr_t, size_t);
@@ -24,4 +72,6 @@ void swaddr_write(swaddr_t, size_t, uint32_t);
 void lnaddr_write(lnaddr_t, size_t, uint32_t);
 void hwaddr_write(hwaddr_t, size_t, uint32_t);
 
+bool swaddr_valid(swaddr_t, size_t, uint8_t);
+
 #endif
@@ -0,0 +1,30 @@
+#ifndef __MMU_H__
+#define __MMU_H__
+
+#include "common.h"
+#include "../../lib-common/x86-inc/mmu.h"
+
+/* the size of a page mapped by a PDE when CR4.PSE is set */
+#define LARGE_PAGE_SIZE				PT_SIZE
+#define LARGE_PAGE_MASK				(PT_SIZE - 1)
+
+/* Translate the linear address with the page tables pointed by CR3,
+ * and set the A bit, and the D bit if `is_write'.
+ */
+hwaddr_t page_translate(lnaddr_t, bool is_write);
+
+/* Translate the linear address for the monitor. Return false if the
+ * page is not present.
+ */
+bool page_probe(lnaddr_t, hwaddr_t *);
+
+/* Drop all cached translations, e.g. after the page tables are changed. */
+void tlb_flush();
+
+/* Drop the cached translations which are not global, when CR3 is written. */
+void tlb_switch_space();
+
+/* Report the page walks and the PDE cache. */
+void mmu_report();
+
+#endif
@@ -12,4 +12,11 @@ inline static void memcpy_with_mask(void *dest, const void *src, size_t len, uin
 	}
 }
 
+/* FNV-1a */
+inline static uint32_t hash_str(const char *s) {
+	uint32_t h = 2166136261u;
+	for(; *s; s ++) { h = (h ^ (uint8_t)*s) * 16777619u; }
+	return h;
+}
+
 #endif
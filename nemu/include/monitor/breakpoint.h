@@ -0,0 +1,22 @@
+#ifndef __BREAKPOINT_H__
+#define __BREAKPOINT_H__
+
+#include "common.h"
+
+/* Breakpoints are kept by NEMU instead of being written into the guest
+ * memory as `int3'. One bit for each page of the address space is set
+ * if there are breakpoints in the page, so that cpu_exec() only looks
+ * up the breakpoints when executing such pages.
+ */
+extern uint8_t bp_page_map[];
+
+#define BP_PAGE_SHIFT 12
+#define bp_page_set(addr) \
+	((bp_page_map[(addr) >> (BP_PAGE_SHIFT + 3)] >> (((addr) >> BP_PAGE_SHIFT) & 0x7)) & 1)
+
+int set_bp(swaddr_t);
+bool clear_bp(swaddr_t);
+int find_bp(swaddr_t);
+void print_bps();
+
+#endif
@@ -0,0 +1,29 @@
+#ifndef __CHECKPOINT_H__
+#define __CHECKPOINT_H__
+
+#include "common.h"
+
+/* When checkpointing is enabled, hwaddr_write() saves the old contents
+ * of a page into the latest checkpoint before the page is first written
+ * after the checkpoint. The bit of the page in `ckpt_dirty_map' is set
+ * after that.
+ */
+extern bool ckpt_enabled;
+extern uint8_t ckpt_dirty_map[];
+
+#define CKPT_PAGE_SHIFT 12
+#define ckpt_page_dirty(addr) \
+	((ckpt_dirty_map[(addr) >> (CKPT_PAGE_SHIFT + 3)] >> (((addr) >> CKPT_PAGE_SHIFT) & 0x7)) & 1)
+
+void ckpt_save_page(hwaddr_t);
+
+/* set when replaying from a checkpoint, to suppress the output of cpu_exec() */
+extern bool replaying;
+
+/* checked by cpu_exec() after each instruction */
+extern uint64_t next_ckpt;
+void take_checkpoint();
+
+void reset_checkpoints();
+
+#endif
@@ -3,6 +3,30 @@
 
 #include "common.h"
 
+/* An expression compiled into the code of a stack machine.
+ * It can be evaluated many times without parsing again.
+ */
+typedef struct Expr Expr;
+
+/* the max number of memory addresses an expression depends on */
+#define EXPR_MAX_DEP 16
+
+/* Compile the expression, or get it from the cache of compiled
+ * expressions. Release it with expr_free() after use.
+ */
+Expr* expr_compile(char *, bool *);
+void expr_free(Expr *);
+
+/* Whether the value of the expression depends on the registers. */
+bool expr_uses_reg(Expr *);
+
+/* Evaluate the expression. If `deps' is not NULL, the addresses of
+ * the 4-byte memory words read during evaluation are recorded into
+ * it, and their number into `nr_dep'. `nr_dep' is set to -1 if there
+ * are more than EXPR_MAX_DEP of them.
+ */
+uint32_t expr_eval(Expr *, swaddr_t *deps, int *nr_dep, bool *);
+
 uint32_t expr(char *, bool *);
 
 #endif
@@ -1,7 +1,12 @@
 #ifndef __MONITOR_H__
 #define __MONITOR_H__
 
+#include "common.h"
+
 enum { STOP, RUNNING, END };
-extern int nemu_state;
+extern __thread int nemu_state;
+
+/* the number of instructions retired since NEMU starts */
+extern __thread uint64_t nr_instr;
 
 #endif
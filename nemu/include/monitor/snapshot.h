@@ -0,0 +1,21 @@
+#ifndef __SNAPSHOT_H__
+#define __SNAPSHOT_H__
+
+#include "common.h"
+
+/* Register a piece of the machine state to be saved into snapshots.
+ * Registering the same name again replaces the old one.
+ */
+void snapshot_register(const char *name, void *addr, size_t size);
+
+/* Copy all registered states into or out of a buffer of
+ * snapshot_state_size() bytes, used by checkpoints.
+ */
+size_t snapshot_state_size();
+void snapshot_save_state(void *buf);
+void snapshot_load_state(const void *buf);
+
+bool savevm(const char *filename);
+bool loadvm(const char *filename);
+
+#endif
@@ -0,0 +1,29 @@
+#ifndef __SYMBOL_H__
+#define __SYMBOL_H__
+
+#include "common.h"
+
+/* The function and object symbols of the guest program. They are indexed
+ * at load time, sorted by address with non-overlapping ranges [start, end).
+ */
+typedef struct {
+	swaddr_t start, end;
+	const char *name;
+	bool is_func;
+} Symbol;
+
+/* Return the value of the symbol named `sym'. */
+swaddr_t look_up_symtab(char *sym, bool *success);
+
+/* Return the index of the symbol containing `addr', or -1 if not found. */
+int find_symbol(swaddr_t addr);
+
+/* Changed whenever the symbols are loaded, so that the values of the
+ * symbols cached elsewhere can be checked.
+ */
+uint32_t symtab_version();
+
+int get_nr_symbol();
+const Symbol* get_symbol(int idx);
+
+#endif
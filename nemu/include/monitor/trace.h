@@ -0,0 +1,39 @@
+#ifndef __TRACE_H__
+#define __TRACE_H__
+
+#include <stdint.h>
+
+/* The format of the binary instruction trace. It is shared by NEMU and
+ * the offline tool (nemu/tools/trace-dump.c), so do not include other
+ * headers of NEMU here.
+ *
+ * The trace file is compressed by zlib. It begins with the magic string
+ * TRACE_MAGIC, followed by a sequence of variable-length records:
+ *
+ *   uint8_t  flags;             TRACE_REG, TRACE_MEM, TRACE_MEM_TRUNC
+ *   uint8_t  len;               length of the instruction
+ *   uint32_t eip;
+ *   uint8_t  instr[len];        raw bytes of the instruction
+ *   if(flags & TRACE_REG):
+ *     uint8_t  mask;            GPRs changed by the instruction
+ *     uint32_t val[popcount(mask)];   new values, from %eax to %edi
+ *   if(flags & TRACE_MEM):
+ *     uint8_t  nr;              number of memory writes
+ *     { uint32_t addr; uint8_t len; uint32_t data; } [nr]
+ *
+ * All multi-byte fields are little-endian and unaligned.
+ */
+
+#define TRACE_MAGIC "NEMUTRC1"
+#define TRACE_MAGIC_LEN 8
+
+#define TRACE_REG		0x1
+#define TRACE_MEM		0x2
+#define TRACE_MEM_TRUNC	0x4		/* more memory writes than TRACE_MAX_MEM */
+
+#define TRACE_MAX_INSTR_LEN 15
+#define TRACE_MAX_MEM 16
+
+#define TRACE_MAX_RECORD_LEN (6 + TRACE_MAX_INSTR_LEN + 1 + 8 * 4 + 1 + TRACE_MAX_MEM * 9)
+
+#endif
@@ -2,14 +2,42 @@
 #define __WATCHPOINT_H__
 
 #include "common.h"
+#include "monitor/expr.h"
 
 typedef struct watchpoint {
 	int NO;
 	struct watchpoint *next;
 
-	/* TODO: Add more members if necessary */
+	char *str;
+	Expr *expr;
+	uint32_t val;
 
+	/* the memory words the value depends on, or -1 if too many */
+	swaddr_t deps[EXPR_MAX_DEP];
+	int nr_dep;
 
+	/* re-evaluated after every instruction */
+	bool eager;
+	/* a memory word it depends on may be changed */
+	bool dirty;
 } WP;
 
+/* One bit for each page of the address space, set if a watchpoint
+ * depends on some memory word in the page. swaddr_write() checks it
+ * so that a watchpoint is only re-evaluated when it may be changed.
+ */
+extern uint8_t wp_page_map[];
+extern bool wp_mem_hit;
+extern int nr_eager_wp;
+
+#define WP_PAGE_SHIFT 12
+#define wp_page_watched(addr) \
+	((wp_page_map[(addr) >> (WP_PAGE_SHIFT + 3)] >> (((addr) >> WP_PAGE_SHIFT) & 0x7)) & 1)
+
+WP* new_wp(char *);
+bool delete_wp(int);
+void print_wps();
+void wp_mem_write(swaddr_t, size_t);
+bool check_watchpoints();
+
 #endif
@@ -14,10 +14,6 @@ make_helper(concat(decode_i_, SUFFIX)) {
 	op_src->type = OP_TYPE_IMM;
 	op_src->imm = instr_fetch(eip, DATA_BYTE);
 	op_src->val = op_src->imm;
-
-#ifdef DEBUG
-	snprintf(op_src->str, OP_STR_SIZE, "$0x%x", op_src->imm);
-#endif
 	return DATA_BYTE;
 }
 
@@ -35,10 +31,6 @@ make_helper(concat(decode_si_, SUFFIX)) {
 	panic("please implement me");
 
 	op_src->val = op_src->simm;
-
-#ifdef DEBUG
-	snprintf(op_src->str, OP_STR_SIZE, "$0x%x", op_src->val);
-#endif
 	return DATA_BYTE;
 }
 #endif
@@ -46,35 +38,40 @@ make_helper(concat(decode_si_, SUFFIX)) {
 /* eAX */
 static int concat(decode_a_, SUFFIX) (swaddr_t eip, Operand *op) {
 	op->type = OP_TYPE_REG;
+	op->size = DATA_BYTE;
 	op->reg = R_EAX;
 	op->val = REG(R_EAX);
-
-#ifdef DEBUG
-	snprintf(op->str, OP_STR_SIZE, "%%%s", REG_NAME(R_EAX));
-#endif
 	return 0;
 }
 
 /* eXX: eAX, eCX, eDX, eBX, eSP, eBP, eSI, eDI */
 static int concat3(decode_r_, SUFFIX, _internal) (swaddr_t eip, Operand *op) {
 	op->type = OP_TYPE_REG;
+	op->size = DATA_BYTE;
 	op->reg = ops_decoded.opcode & 0x7;
 	op->val = REG(op->reg);
-
-#ifdef DEBUG
-	snprintf(op->str, OP_STR_SIZE, "%%%s", REG_NAME(op->reg));
-#endif
 	return 0;
 }
 
+/* Like read_ModR_M(), but the size of the operands is known here. */
 static int concat3(decode_rm_, SUFFIX, _internal) (swaddr_t eip, Operand *rm, Operand *reg) {
-	rm->size = DATA_BYTE;
-	int len = read_ModR_M(eip, rm, reg);
-	reg->val = REG(reg->reg);
+	ModR_M m;
+	m.val = instr_fetch(eip, 1);
+	reg->type = OP_TYPE_REG;
+	reg->size = DATA_BYTE;
+	reg->reg = m.reg;
+	reg->val = REG(m.reg);
 
-#ifdef DEBUG
-	snprintf(reg->str, OP_STR_SIZE, "%%%s", REG_NAME(reg->reg));
-#endif
+	rm->size = DATA_BYTE;
+	if(m.mod == 3) {
+		rm->type = OP_TYPE_REG;
+		rm->reg = m.R_M;
+		rm->val = REG(m.R_M);
+		return 1;
+	}
+
+	int len = load_addr(eip, &m, rm);
+	rm->val = MEM_R(rm->addr);
 	return len;
 }
 
@@ -156,20 +153,15 @@ make_helper(concat(decode_rm_1_, SUFFIX)) {
 	op_src->type = OP_TYPE_IMM;
 	op_src->imm = 1;
 	op_src->val = 1;
-#ifdef DEBUG
-	sprintf(op_src->str, "$1");
-#endif
 	return len;
 }
 
 make_helper(concat(decode_rm_cl_, SUFFIX)) {
 	int len = decode_r2rm(eip);
 	op_src->type = OP_TYPE_REG;
+	op_src->size = 1;
 	op_src->reg = R_CL;
 	op_src->val = reg_b(R_CL);
-#ifdef DEBUG
-	sprintf(op_src->str, "%%cl");
-#endif
 	return len;
 }
 
@@ -2,7 +2,7 @@
 #include "cpu/decode/decode.h"
 
 /* shared by all helper function */
-Operands ops_decoded;
+__thread Operands ops_decoded;
 
 #define DATA_BYTE 1
 #include "decode-template.h"
@@ -0,0 +1,80 @@
+#include "cpu/exec/helper.h"
+
+/* Generate the assembly code from the decoded operands. This is
+ * done only when the assembly code is actually needed, so that
+ * the decode helpers do not pay for it.
+ */
+
+static void mem_str(Operand *op, char *buf) {
+	char disp_buf[16];
+	char base_buf[8];
+	char index_buf[16];
+	int32_t disp = op->mem.disp;
+
+	if(op->mem.disp_size != 0) {
+		/* has disp */
+		sprintf(disp_buf, "%s%#x", (disp < 0 ? "-" : ""), (disp < 0 ? -disp : disp));
+	}
+	else { disp_buf[0] = '\0'; }
+
+	if(op->mem.base == -1) { base_buf[0] = '\0'; }
+	else {
+		sprintf(base_buf, "%%%s", regsl[op->mem.base]);
+	}
+
+	if(op->mem.index == -1) { index_buf[0] = '\0'; }
+	else {
+		sprintf(index_buf, ",%%%s,%d", regsl[op->mem.index], 1 << op->mem.scale);
+	}
+
+	if(op->mem.base == -1 && op->mem.index == -1) {
+		sprintf(buf, "%s", disp_buf);
+	}
+	else {
+		sprintf(buf, "%s(%s%s)", disp_buf, base_buf, index_buf);
+	}
+}
+
+/* The result is kept until operand_str() is called four more times,
+ * so that it can be used several times in one print_asm().
+ */
+const char* operand_str(Operand *op) {
+	static __thread char bufs[4][OP_STR_SIZE];
+	static __thread int k = 0;
+	char *buf = bufs[k];
+	k = (k + 1) % 4;
+
+	switch(op->type) {
+		case OP_TYPE_REG:
+			switch(op->size) {
+				case 1: sprintf(buf, "%%%s", regsb[op->reg]); break;
+				case 2: sprintf(buf, "%%%s", regsw[op->reg]); break;
+				case 4: sprintf(buf, "%%%s", regsl[op->reg]); break;
+				default: assert(0);
+			}
+			break;
+		case OP_TYPE_MEM: mem_str(op, buf); break;
+		case OP_TYPE_IMM: sprintf(buf, "$0x%x", op->imm); break;
+		default: assert(0);
+	}
+
+	return buf;
+}
+
+/* Return the assembly code of the instruction executed most recently. */
+const char* get_asm() {
+	const char *name = ops_decoded.asm_name;
+	if(name == NULL) { return assembly; }
+
+	switch(ops_decoded.asm_nr_op) {
+		case 1: snprintf(assembly, 80, "%s %s", name, operand_str(op_src)); break;
+		case 2: snprintf(assembly, 80, "%s %s,%s", name,
+						operand_str(op_src), operand_str(op_dest)); break;
+		case 3: snprintf(assembly, 80, "%s %s,%s,%s", name,
+						operand_str(op_src), operand_str(op_src2), operand_str(op_dest)); break;
+		default: assert(0);
+	}
+
+	ops_decoded.asm_name = NULL;
+	return assembly;
+}
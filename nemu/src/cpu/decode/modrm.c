@@ -1,86 +1,81 @@
 #include "cpu/decode/modrm.h"
 #include "cpu/helper.h"
 
+/* The addressing modes of all ModR/M and SIB bytes, generated at compile
+ * time, so that computing the effective address needs no decoding.
+ */
+typedef struct {
+	int8_t base, index;		/* -1 if not used */
+	uint8_t scale;
+	uint8_t disp_size;
+	uint8_t disp_offset;	/* the length of ModR/M and SIB */
+	bool stack;				/* whether SS is the default segment */
+} AddrMode;
+
+#define T4(f, n) f(n) f(n + 1) f(n + 2) f(n + 3)
+#define T16(f, n) T4(f, n) T4(f, n + 4) T4(f, n + 8) T4(f, n + 12)
+#define T64(f, n) T16(f, n) T16(f, n + 16) T16(f, n + 32) T16(f, n + 48)
+#define T256(f) T64(f, 0) T64(f, 64) T64(f, 128) T64(f, 192)
+
+#define MOD(v) ((v) >> 6)
+#define LOW(v) ((v) & 0x7)
+#define MID(v) (((v) >> 3) & 0x7)
+
+/* The displacement follows the ModR/M byte, or the SIB byte if there is one.
+ * With mod = 0, EBP means no base but a disp32.
+ */
+#define DISP_SIZE(mod, base) ((mod) == 1 ? 1 : ((mod) == 2 || (base) == R_EBP) ? 4 : 0)
+#define BASE(mod, base) ((mod) == 0 && (base) == R_EBP ? -1 : (base))
+#define STACK(mod, base) (BASE(mod, base) == R_ESP || BASE(mod, base) == R_EBP)
+
+/* Entries with R/M = ESP are replaced by the entries for the SIB byte. */
+#define MODRM_MODE(v) { \
+	.base = BASE(MOD(v), LOW(v)), .index = -1, .scale = 0, \
+	.disp_size = DISP_SIZE(MOD(v), LOW(v)), .disp_offset = 1, \
+	.stack = STACK(MOD(v), LOW(v)) },
+
+#define SIB_MODE(mod, v) { \
+	.base = BASE(mod, LOW(v)), .index = (MID(v) == R_ESP ? -1 : MID(v)), .scale = MOD(v), \
+	.disp_size = DISP_SIZE(mod, LOW(v)), .disp_offset = 2, \
+	.stack = STACK(mod, LOW(v)) },
+#define SIB_MODE0(v) SIB_MODE(0, v)
+#define SIB_MODE1(v) SIB_MODE(1, v)
+#define SIB_MODE2(v) SIB_MODE(2, v)
+
+static const AddrMode modrm_mode[256] = { T256(MODRM_MODE) };
+
+/* indexed by mod and the SIB byte */
+static const AddrMode sib_mode[3][256] = {
+	{ T256(SIB_MODE0) }, { T256(SIB_MODE1) }, { T256(SIB_MODE2) }
+};
+
 int load_addr(swaddr_t eip, ModR_M *m, Operand *rm) {
 	assert(m->mod != 3);
 
-	int32_t disp;
-	int instr_len, disp_offset, disp_size = 4;
-	int base_reg = -1, index_reg = -1, scale = 0;
-	swaddr_t addr = 0;
-
-	if(m->R_M == R_ESP) {
-		SIB s;
-		s.val = instr_fetch(eip + 1, 1);
-		base_reg = s.base;
-		disp_offset = 2;
-		scale = s.ss;
-
-		if(s.index != R_ESP) { index_reg = s.index; }
-	}
-	else {
-		/* no SIB */
-		base_reg = m->R_M;
-		disp_offset = 1;
-	}
-
-	if(m->mod == 0) {
-		if(base_reg == R_EBP) { base_reg = -1; }
-		else { disp_size = 0; }
-	}
-	else if(m->mod == 1) { disp_size = 1; }
-
-	instr_len = disp_offset;
-	if(disp_size != 0) {
-		/* has disp */
-		disp = instr_fetch(eip + disp_offset, disp_size);
-		if(disp_size == 1) { disp = (int8_t)disp; }
-
-		instr_len += disp_size;
-		addr += disp;
-	}
-
-	if(base_reg != -1) {
-		addr += reg_l(base_reg);
-	}
-
-	if(index_reg != -1) {
-		addr += reg_l(index_reg) << scale;
-	}
+	const AddrMode *a = &modrm_mode[m->val];
+	if(m->R_M == R_ESP) { a = &sib_mode[m->mod][instr_fetch(eip + 1, 1)]; }
 
-#ifdef DEBUG
-	char disp_buf[16];
-	char base_buf[8];
-	char index_buf[8];
+	int32_t disp = 0;
+	if(a->disp_size == 1) { disp = (int8_t)instr_fetch(eip + a->disp_offset, 1); }
+	else if(a->disp_size == 4) { disp = instr_fetch(eip + a->disp_offset, 4); }
 
-	if(disp_size != 0) {
-		/* has disp */
-		sprintf(disp_buf, "%s%#x", (disp < 0 ? "-" : ""), (disp < 0 ? -disp : disp));
-	}
-	else { disp_buf[0] = '\0'; }
-
-	if(base_reg == -1) { base_buf[0] = '\0'; }
-	else { 
-		sprintf(base_buf, "%%%s", regsl[base_reg]); 
-	}
+	swaddr_t addr = disp;
+	if(a->base != -1) { addr += reg_l(a->base); }
+	if(a->index != -1) { addr += reg_l(a->index) << a->scale; }
 
-	if(index_reg == -1) { index_buf[0] = '\0'; }
-	else { 
-		sprintf(index_buf, ",%%%s,%d", regsl[index_reg], 1 << scale); 
-	}
+	/* The stack segment is the default with ESP or EBP as the base. */
+	if(a->stack && !ops_decoded.seg_override) { current_sreg = R_SS; }
 
-	if(base_reg == -1 && index_reg == -1) {
-		sprintf(rm->str, "%s", disp_buf);
-	}
-	else {
-		sprintf(rm->str, "%s(%s%s)", disp_buf, base_buf, index_buf);
-	}
-#endif
+	rm->mem.base = a->base;
+	rm->mem.index = a->index;
+	rm->mem.scale = a->scale;
+	rm->mem.disp_size = a->disp_size;
+	rm->mem.disp = disp;
 
 	rm->type = OP_TYPE_MEM;
 	rm->addr = addr;
 
-	return instr_len;
+	return a->disp_offset + a->disp_size;
 }
 
 int read_ModR_M(swaddr_t eip, Operand *rm, Operand *reg) {
@@ -98,13 +93,6 @@ int read_ModR_M(swaddr_t eip, Operand *rm, Operand *reg) {
 			case 4: rm->val = reg_l(m.R_M); break;
 			default: assert(0);
 		}
-#ifdef DEBUG
-		switch(rm->size) {
-			case 1: sprintf(rm->str, "%%%s", regsb[m.R_M]); break;
-			case 2: sprintf(rm->str, "%%%s", regsw[m.R_M]); break;
-			case 4: sprintf(rm->str, "%%%s", regsl[m.R_M]); break;
-		}
-#endif
 		return 1;
 	}
 	else {
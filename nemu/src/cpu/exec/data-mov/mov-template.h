@@ -2,15 +2,20 @@
 
 #define instr mov
 
-static void do_execute() {
-	OPERAND_W(op_dest, op_src->val);
-	print_asm_template2();
+static inline DATA_TYPE do_op(DATA_TYPE dest, DATA_TYPE src) {
+	return src;
 }
 
-make_instr_helper(i2r)
-make_instr_helper(i2rm)
-make_instr_helper(r2rm)
-make_instr_helper(rm2r)
+make_form_helpers(0)
+
+make_helper(concat(mov_i2r_, SUFFIX)) {
+	int reg = instr_fetch(eip, 1) & 0x7;
+	DATA_TYPE imm = instr_fetch(eip + 1, DATA_BYTE);
+	REG(reg) = imm;
+
+	print_asm("mov" str(SUFFIX) " $0x%x,%%%s", imm, REG_NAME(reg));
+	return 1 + DATA_BYTE;
+}
 
 make_helper(concat(mov_a2moffs_, SUFFIX)) {
 	swaddr_t addr = instr_fetch(eip + 1, 4);
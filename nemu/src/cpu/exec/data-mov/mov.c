@@ -1,4 +1,6 @@
 #include "cpu/exec/helper.h"
+#include "cpu/decode/modrm.h"
+#include "memory/mmu.h"
 
 #define DATA_BYTE 1
 #include "mov-template.h"
@@ -20,3 +22,75 @@ make_helper_v(mov_r2rm)
 make_helper_v(mov_rm2r)
 make_helper_v(mov_a2moffs)
 make_helper_v(mov_moffs2a)
+
+/* move to/from control registers */
+
+static uint32_t *cr(int idx) {
+	switch(idx) {
+		case 0: return &cpu.cr0.val;
+		case 3: return &cpu.cr3.val;
+		case 4: return &cpu.cr4.val;
+		default: panic("eip = 0x%08x: CR%d is not supported", cpu.eip, idx);
+	}
+}
+
+make_helper(mov_cr2r) {
+	ModR_M m;
+	m.val = instr_fetch(eip + 1, 1);
+	reg_l(m.R_M) = *cr(m.reg);
+
+	print_asm("movl %%cr%d,%%%s", m.reg, regsl[m.R_M]);
+	return 2;
+}
+
+make_helper(mov_r2cr) {
+	ModR_M m;
+	m.val = instr_fetch(eip + 1, 1);
+	*cr(m.reg) = reg_l(m.R_M);
+
+	/* The cached translations may be stale now. The global ones are
+	 * kept when switching to another address space.
+	 */
+	if(m.reg == 3) { tlb_switch_space(); }
+	else { tlb_flush(); }
+
+	print_asm("movl %%%s,%%cr%d", regsl[m.R_M], m.reg);
+	return 2;
+}
+
+/* move to/from segment registers */
+
+make_helper(mov_rm2s) {
+	ModR_M m;
+	m.val = instr_fetch(eip + 1, 1);
+	Assert(m.reg <= R_GS && m.reg != R_CS, "eip = 0x%08x: invalid segment register %d", cpu.eip, m.reg);
+	op_src->size = 2;
+	int len = read_ModR_M(eip + 1, op_src, op_dest);
+	load_sreg(m.reg, op_src->val);
+
+	print_asm("movw %s,%%%s", operand_str(op_src), sregs[m.reg]);
+	return 1 + len;
+}
+
+make_helper(mov_s2rm) {
+	ModR_M m;
+	m.val = instr_fetch(eip + 1, 1);
+	Assert(m.reg <= R_GS, "eip = 0x%08x: invalid segment register %d", cpu.eip, m.reg);
+	uint16_t selector = cpu.sreg[m.reg].selector;
+	int len = 1;
+	if(m.mod == 3) {
+		/* zero-extended with 32-bit operand size */
+		if(ops_decoded.is_operand_size_16) { reg_w(m.R_M) = selector; }
+		else { reg_l(m.R_M) = selector; }
+		op_dest->type = OP_TYPE_REG;
+		op_dest->reg = m.R_M;
+	}
+	else {
+		len = load_addr(eip + 1, &m, op_dest);
+		swaddr_write(op_dest->addr, 2, selector);
+	}
+	op_dest->size = 2;
+
+	print_asm("movw %%%s,%s", sregs[m.reg], operand_str(op_dest));
+	return 1 + len;
+}
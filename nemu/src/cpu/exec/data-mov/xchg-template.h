@@ -13,9 +13,9 @@ static void do_execute () {
 make_helper(concat(xchg_a2r_, SUFFIX)) {
 	concat(decode_r_, SUFFIX)(eip);
 	op_dest->type = OP_TYPE_REG;
+	op_dest->size = DATA_BYTE;
 	op_dest->reg = R_EAX;
 	op_dest->val = REG(R_EAX);
-	snprintf(op_dest->str, OP_STR_SIZE, "%s", REG_NAME(R_EAX));
 	do_execute();
 	return 1;
 }
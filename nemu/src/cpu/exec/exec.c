@@ -6,6 +6,17 @@
 typedef int (*helper_fun)(swaddr_t);
 static make_helper(_2byte_esc);
 
+#ifdef OPCODE_STAT
+extern __thread int group_stat_idx;
+extern __thread helper_fun group_helper;
+
+/* Record which sub-opcode of the group is dispatched to. */
+#define record_group(sub, helper) \
+	(group_stat_idx = 0x200 + (ops_decoded.opcode << 3) + (sub), group_helper = (helper))
+#else
+#define record_group(sub, helper)
+#endif
+
 #define make_group(name, item0, item1, item2, item3, item4, item5, item6, item7) \
 	static helper_fun concat(opcode_table_, name) [8] = { \
 	/* 0x00 */	item0, item1, item2, item3, \
@@ -14,6 +25,7 @@ static make_helper(_2byte_esc);
 	static make_helper(name) { \
 		ModR_M m; \
 		m.val = instr_fetch(eip + 1, 1); \
+		record_group(m.opcode, concat(opcode_table_, name) [m.opcode]); \
 		return concat(opcode_table_, name) [m.opcode](eip); \
 	}
 	
@@ -87,7 +99,7 @@ make_group(group6,
 	inv, inv, inv, inv)
 
 make_group(group7,
-	inv, inv, inv, inv, 
+	inv, inv, lgdt, inv, 
 	inv, inv, inv, inv)
 
 
@@ -103,13 +115,13 @@ helper_fun opcode_table [256] = {
 /* 0x18 */	inv, inv, inv, inv,
 /* 0x1c */	inv, inv, inv, inv,
 /* 0x20 */	inv, inv, inv, inv,
-/* 0x24 */	inv, inv, inv, inv,
+/* 0x24 */	inv, inv, seg_override, inv,
 /* 0x28 */	inv, inv, inv, inv,
-/* 0x2c */	inv, inv, inv, inv,
+/* 0x2c */	inv, inv, seg_override, inv,
 /* 0x30 */	inv, inv, inv, inv,
-/* 0x34 */	inv, inv, inv, inv,
+/* 0x34 */	inv, inv, seg_override, inv,
 /* 0x38 */	inv, inv, inv, inv,
-/* 0x3c */	inv, inv, inv, inv,
+/* 0x3c */	inv, inv, seg_override, inv,
 /* 0x40 */	inv, inv, inv, inv,
 /* 0x44 */	inv, inv, inv, inv,
 /* 0x48 */	inv, inv, inv, inv,
@@ -119,7 +131,7 @@ helper_fun opcode_table [256] = {
 /* 0x58 */	inv, inv, inv, inv,
 /* 0x5c */	inv, inv, inv, inv,
 /* 0x60 */	inv, inv, inv, inv,
-/* 0x64 */	inv, inv, operand_size, inv,
+/* 0x64 */	seg_override, seg_override, operand_size, inv,
 /* 0x68 */	inv, inv, inv, inv,
 /* 0x6c */	inv, inv, inv, inv,
 /* 0x70 */	inv, inv, inv, inv,
@@ -129,7 +141,7 @@ helper_fun opcode_table [256] = {
 /* 0x80 */	group1_b, group1_v, inv, group1_sx_v, 
 /* 0x84 */	inv, inv, inv, inv,
 /* 0x88 */	mov_r2rm_b, mov_r2rm_v, mov_rm2r_b, mov_rm2r_v,
-/* 0x8c */	inv, inv, inv, inv,
+/* 0x8c */	mov_s2rm, inv, mov_rm2s, inv,
 /* 0x90 */	inv, inv, inv, inv,
 /* 0x94 */	inv, inv, inv, inv,
 /* 0x98 */	inv, inv, inv, inv,
@@ -152,7 +164,7 @@ helper_fun opcode_table [256] = {
 /* 0xdc */	inv, inv, inv, inv,
 /* 0xe0 */	inv, inv, inv, inv,
 /* 0xe4 */	inv, inv, inv, inv,
-/* 0xe8 */	inv, inv, inv, inv,
+/* 0xe8 */	inv, inv, ljmp, inv,
 /* 0xec */	inv, inv, inv, inv,
 /* 0xf0 */	inv, inv, inv, inv,
 /* 0xf4 */	inv, inv, group3_b, group3_v,
@@ -169,7 +181,7 @@ helper_fun _2byte_opcode_table [256] = {
 /* 0x14 */	inv, inv, inv, inv, 
 /* 0x18 */	inv, inv, inv, inv, 
 /* 0x1c */	inv, inv, inv, inv, 
-/* 0x20 */	inv, inv, inv, inv, 
+/* 0x20 */	mov_cr2r, inv, mov_r2cr, inv, 
 /* 0x24 */	inv, inv, inv, inv,
 /* 0x28 */	inv, inv, inv, inv, 
 /* 0x2c */	inv, inv, inv, inv, 
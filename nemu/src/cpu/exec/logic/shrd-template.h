@@ -18,7 +18,7 @@ static void do_execute () {
 
 	OPERAND_W(op_src2, out);
 
-	print_asm("shrd" str(SUFFIX) " %s,%s,%s", op_src->str, op_dest->str, op_src2->str);
+	print_asm("shrd" str(SUFFIX) " %s,%s,%s", operand_str(op_src), operand_str(op_dest), operand_str(op_src2));
 }
 
 make_helper(concat(shrdi_, SUFFIX)) {
@@ -20,6 +20,30 @@ make_helper(lea) {
 	int len = load_addr(eip + 1, &m, op_src);
 	reg_l(m.reg) = op_src->addr;
 
-	print_asm("leal %s,%%%s", op_src->str, regsl[m.reg]);
+	print_asm("leal %s,%%%s", operand_str(op_src), regsl[m.reg]);
 	return 1 + len;
 }
+
+make_helper(lgdt) {
+	ModR_M m;
+	m.val = instr_fetch(eip + 1, 1);
+	int len = load_addr(eip + 1, &m, op_src);
+	cpu.gdtr.limit = swaddr_read(op_src->addr, 2);
+	cpu.gdtr.base = swaddr_read(op_src->addr + 2, 4);
+	/* only 24 bits of the base are loaded with 16-bit operand size */
+	if(ops_decoded.is_operand_size_16) { cpu.gdtr.base &= 0xffffff; }
+
+	print_asm("lgdt%s %s", (ops_decoded.is_operand_size_16 ? "w" : "l"), operand_str(op_src));
+	return 1 + len;
+}
+
+/* 0xea: jump to ptr16:32, reloading CS */
+make_helper(ljmp) {
+	uint32_t offset = instr_fetch(eip + 1, 4);
+	uint16_t selector = instr_fetch(eip + 5, 2);
+	load_sreg(R_CS, selector);
+	cpu.eip = offset - 7;
+
+	print_asm("ljmp $0x%x,$0x%x", selector, offset);
+	return 7;
+}
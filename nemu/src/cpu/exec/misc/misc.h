@@ -4,5 +4,7 @@
 make_helper(nop);
 make_helper(int3);
 make_helper(lea);
+make_helper(lgdt);
+make_helper(ljmp);
 
 #endif
@@ -0,0 +1,140 @@
+/* dladdr() is a GNU extension */
+#define _GNU_SOURCE
+
+#include "cpu/helper.h"
+
+#ifdef OPCODE_STAT
+
+#include <stdlib.h>
+#include <dlfcn.h>
+#include <pthread.h>
+#include <x86intrin.h>
+
+typedef int (*helper_fun)(swaddr_t);
+
+make_helper(exec);
+
+extern helper_fun opcode_table[];
+extern helper_fun _2byte_opcode_table[];
+
+/* Statistics are indexed by
+ * 0x000 - 0x0ff: one-byte opcodes
+ * 0x100 - 0x1ff: two-byte opcodes (0x0f xx)
+ * 0x200 - ...  : sub-opcodes of groups, 0x200 + (opcode << 3) + ModR/M.opcode
+ */
+#define NR_OPCODE_STAT (0x200 + (0x200 << 3))
+
+typedef struct {
+	uint64_t cnt;
+	uint64_t cycles;
+	helper_fun helper;
+} OpcodeStat;
+
+/* Each thread running a machine counts into its own table, which is
+ * added to `total_stat' by opcode_stat_merge().
+ */
+static __thread OpcodeStat opcode_stat[NR_OPCODE_STAT];
+static OpcodeStat total_stat[NR_OPCODE_STAT];
+static pthread_mutex_t total_stat_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* set by the groups in exec.c */
+__thread int group_stat_idx;
+__thread helper_fun group_helper;
+
+/* Execute one instruction and charge it to the helper executing it. */
+make_helper(exec_stat) {
+	group_stat_idx = -1;
+
+	uint64_t start = __rdtsc();
+	int len = exec(eip);
+	uint64_t cycles = __rdtsc() - start;
+
+	int idx;
+	helper_fun helper;
+	if(group_stat_idx != -1) {
+		idx = group_stat_idx;
+		helper = group_helper;
+	}
+	else {
+		idx = ops_decoded.opcode;
+		helper = (idx < 0x100 ? opcode_table[idx] : _2byte_opcode_table[idx & 0xff]);
+	}
+
+	opcode_stat[idx].cnt ++;
+	opcode_stat[idx].cycles += cycles;
+	opcode_stat[idx].helper = helper;
+	return len;
+}
+
+/* Add the statistics of the current thread to the total, e.g. when a job
+ * of the batch mode finishes.
+ */
+void opcode_stat_merge() {
+	int i;
+	pthread_mutex_lock(&total_stat_lock);
+	for(i = 0; i < NR_OPCODE_STAT; i ++) {
+		if(opcode_stat[i].cnt != 0) {
+			total_stat[i].cnt += opcode_stat[i].cnt;
+			total_stat[i].cycles += opcode_stat[i].cycles;
+			total_stat[i].helper = opcode_stat[i].helper;
+		}
+	}
+	pthread_mutex_unlock(&total_stat_lock);
+	memset(opcode_stat, 0, sizeof(opcode_stat));
+}
+
+static void opcode_str(int idx, char *buf) {
+	if(idx < 0x100) { sprintf(buf, "%02x", idx); }
+	else if(idx < 0x200) { sprintf(buf, "0f %02x", idx & 0xff); }
+	else {
+		int opcode = (idx - 0x200) >> 3;
+		sprintf(buf, "%s%02x /%d", (opcode < 0x100 ? "" : "0f "), opcode & 0xff, idx & 0x7);
+	}
+}
+
+static int stat_cmp(const void *a, const void *b) {
+	uint64_t x = total_stat[*(int *)a].cnt;
+	uint64_t y = total_stat[*(int *)b].cnt;
+	return (x < y) - (x > y);
+}
+
+void opcode_stat_report() {
+	int idx[NR_OPCODE_STAT];
+	int nr_idx = 0, i;
+	uint64_t total_cnt = 0, total_cycles = 0;
+
+	opcode_stat_merge();
+
+	for(i = 0; i < NR_OPCODE_STAT; i ++) {
+		if(total_stat[i].cnt != 0) {
+			idx[nr_idx ++] = i;
+			total_cnt += total_stat[i].cnt;
+			total_cycles += total_stat[i].cycles;
+		}
+	}
+
+	if(nr_idx == 0) { return; }
+
+	qsort(idx, nr_idx, sizeof(int), stat_cmp);
+
+	printf("%-9s %-20s %14s %7s %10s %7s\n", "opcode", "helper", "count", "count%", "cycles/ins", "cycles%");
+	for(i = 0; i < nr_idx; i ++) {
+		char buf[16];
+		Dl_info info;
+		const char *name = "?";
+
+		opcode_str(idx[i], buf);
+		if(dladdr((void *)total_stat[idx[i]].helper, &info) && info.dli_sname != NULL) {
+			name = info.dli_sname;
+		}
+
+		uint64_t cnt = total_stat[idx[i]].cnt;
+		uint64_t cycles = total_stat[idx[i]].cycles;
+		printf("%-9s %-20s %14llu %6.2f%% %10.1f %6.2f%%\n", buf, name, (unsigned long long)cnt,
+				cnt * 100.0 / total_cnt, (double)cycles / cnt, cycles * 100.0 / total_cycles);
+	}
+	printf("%llu instructions, %.1f host cycles per instruction\n",
+			(unsigned long long)total_cnt, (double)total_cycles / total_cnt);
+}
+
+#endif
@@ -8,3 +8,13 @@ make_helper(operand_size) {
 	ops_decoded.is_operand_size_16 = false;
 	return instr_len + 1;
 }
+
+/* 0x26, 0x2e, 0x36, 0x3e, 0x64, 0x65 */
+make_helper(seg_override) {
+	uint8_t opcode = instr_fetch(eip, 1);
+	current_sreg = (opcode >= 0x64 ? R_FS + (opcode - 0x64) : (opcode >> 3) & 0x3);
+	ops_decoded.seg_override = true;
+	int instr_len = exec(eip + 1);
+	ops_decoded.seg_override = false;
+	return instr_len + 1;
+}
@@ -1,5 +1,8 @@
 #include "cpu/exec/helper.h"
 #include "monitor/monitor.h"
+#include "../../lib-common/trap.h"
+
+void do_hypercall();
 
 make_helper(inv) {
 	/* invalid opcode */
@@ -28,9 +31,18 @@ make_helper(nemu_trap) {
 	print_asm("nemu trap (eax = %d)", cpu.eax);
 
 	switch(cpu.eax) {
-		case 2:
+		case NEMU_HC_NOP:
 		   	break;
 
+		case NEMU_HC_INSTR_CNT:
+		case NEMU_HC_HOST_TIME:
+		case NEMU_HC_REGION_BEGIN:
+		case NEMU_HC_REGION_END:
+		case NEMU_HC_DUMP_STATS:
+		case NEMU_HC_GET_INPUT:
+			do_hypercall();
+			break;
+
 		default:
 			printf("\33[1;31mnemu: HIT %s TRAP\33[0m at eip = 0x%08x\n\n",
 					(cpu.eax == 0 ? "GOOD" : "BAD"), cpu.eip);
@@ -32,9 +32,12 @@ make_helper(rep) {
 	}
 
 #ifdef DEBUG
-	char temp[80];
-	sprintf(temp, "rep %s", assembly);
-	sprintf(assembly, "%s[cnt = %d]", temp, count);
+	if(asm_requested) {
+		/* print_asm() drops the assembly code recorded by the string instruction */
+		char temp[80];
+		strcpy(temp, get_asm());
+		print_asm("rep %s[cnt = %d]", temp, count);
+	}
 #endif
 	
 	return len + 1;
@@ -57,9 +60,12 @@ make_helper(repnz) {
 	}
 
 #ifdef DEBUG
-	char temp[80];
-	sprintf(temp, "repnz %s", assembly);
-	sprintf(assembly, "%s[cnt = %d]", temp, count);
+	if(asm_requested) {
+		/* print_asm() drops the assembly code recorded by the string instruction */
+		char temp[80];
+		strcpy(temp, get_asm());
+		print_asm("repnz %s[cnt = %d]", temp, count);
+	}
 #endif
 
 	return 1 + 1;
@@ -0,0 +1,62 @@
+#include "nemu.h"
+#include "memory/mmu.h"
+
+/* Segmentation. The descriptor of a segment register is read from the
+ * GDT only when the register is written, and kept in the hidden part of
+ * the register. Flat segments are marked, so that translating addresses
+ * in the flat model costs nothing.
+ */
+
+__thread uint8_t current_sreg = R_DS;
+
+static void set_flat(SegReg *s) {
+	s->base = 0;
+	s->limit = 0xffffffff;
+	s->flat = true;
+}
+
+void reset_sregs() {
+	int i;
+	for(i = R_ES; i <= R_GS; i ++) {
+		cpu.sreg[i].selector = 0;
+		cpu.sreg[i].type = 0;
+		cpu.sreg[i].dpl = 0;
+		set_flat(&cpu.sreg[i]);
+	}
+	cpu.gdtr.base = 0;
+	cpu.gdtr.limit = 0;
+	current_sreg = R_DS;
+	fetch_window_flush();
+}
+
+void load_sreg(int sreg, uint16_t selector) {
+	SegReg *s = &cpu.sreg[sreg];
+	uint32_t idx = selector >> 3;
+
+	if(sreg == R_CS) { fetch_window_flush(); }
+
+	s->selector = selector;
+	if(idx == 0) {
+		/* the null selector, the segment can not be used */
+		Assert(sreg != R_CS && sreg != R_SS, "eip = 0x%08x: load null selector into %%%s", cpu.eip, sregs[sreg]);
+		s->base = 0;
+		s->limit = 0;
+		s->flat = false;
+		return;
+	}
+
+	Assert((selector & 0x4) == 0, "eip = 0x%08x: LDT is not supported", cpu.eip);
+	Assert(idx * 8 + 7 <= cpu.gdtr.limit, "eip = 0x%08x: selector 0x%x is beyond the GDT", cpu.eip, selector);
+
+	lnaddr_t addr = cpu.gdtr.base + idx * 8;
+	uint32_t desc[2] = { lnaddr_read(addr, 4), lnaddr_read(addr + 4, 4) };
+	SegDesc *d = (void *)desc;
+	Assert(d->present, "eip = 0x%08x: segment 0x%x is not present", cpu.eip, selector);
+
+	s->base = d->base_15_0 | (d->base_23_16 << 16) | (d->base_31_24 << 24);
+	s->limit = d->limit_15_0 | (d->limit_19_16 << 16);
+	if(d->granularity) { s->limit = (s->limit << 12) | 0xfff; }
+	s->type = d->type;
+	s->dpl = d->privilege_level;
+	s->flat = (s->base == 0 && s->limit == 0xffffffff);
+}
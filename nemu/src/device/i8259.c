@@ -1,5 +1,6 @@
 #include "common.h"
 #include "cpu/reg.h"
+#include "monitor/snapshot.h"
 
 #define IRQ_BASE 32
 #define NO_INTR -1
@@ -78,6 +79,12 @@ void i8259_raise_intr(int n) {
 	do_i8259();
 }
 
+void init_i8259() {
+	snapshot_register("i8259-master", &master, sizeof(master));
+	snapshot_register("i8259-slave", &slave, sizeof(slave));
+	snapshot_register("i8259-intr", &intr_NO, sizeof(intr_NO));
+}
+
 /* CPU interface */
 uint8_t i8259_query_intr() {
 	return intr_NO;
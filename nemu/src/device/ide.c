@@ -2,6 +2,7 @@
 #include "memory/memory.h"
 #include "device/port-io.h"
 #include "device/i8259.h"
+#include "monitor/snapshot.h"
 
 #define IDE_CTRL_PORT 0x3F6
 #define IDE_PORT 0x1F0
@@ -104,6 +105,8 @@ void bmr_io_handler(ioaddr_t addr, size_t len, bool is_write) {
 					fseek(disk_fp, disk_idx, SEEK_SET);
 
 					ret = fread((void *)hwa_to_va(addr), byte_cnt, 1, disk_fp);
+					/* the code may be loaded by DMA */
+					code_page_write(addr, byte_cnt);
 					assert(ret == 1 || feof(disk_fp));
 
 					/* We only implement PRDT of single entry. */
@@ -129,6 +132,11 @@ void init_ide() {
 	bmr_base = add_pio_map(BMR_PORT, 8, bmr_io_handler);
 	bmr_base[0] = 0;
 
+	snapshot_register("ide-sector", &sector, sizeof(sector));
+	snapshot_register("ide-disk-idx", &disk_idx, sizeof(disk_idx));
+	snapshot_register("ide-byte-cnt", &byte_cnt, sizeof(byte_cnt));
+	snapshot_register("ide-write", &ide_write, sizeof(ide_write));
+
 	extern char *exec_file;
 	disk_fp = fopen(exec_file, "r+");
 	Assert(disk_fp, "Can not open '%s'", exec_file);
@@ -1,6 +1,7 @@
 #include "common.h"
 #include "device/mmio.h"
 #include "misc.h"
+#include "monitor/snapshot.h"
 
 #define MMIO_SPACE_MAX (256 * 1024)
 #define NR_MAP 8
@@ -28,6 +29,11 @@ void* add_mmio_map(hwaddr_t addr, size_t len, mmio_callback_t callback) {
 	maps[nr_map].high = addr + len - 1;
 	maps[nr_map].mmio_space = space_base;
 	maps[nr_map].callback = callback;
+
+	static char names[NR_MAP][16];
+	sprintf(names[nr_map], "mmio-%08x", addr);
+	snapshot_register(names[nr_map], space_base, len);
+
 	nr_map ++;
 	mmio_space_free_index += len;
 	return space_base;
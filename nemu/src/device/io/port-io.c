@@ -1,5 +1,6 @@
 #include "common.h"
 #include "device/port-io.h"
+#include "monitor/snapshot.h"
 
 #define PORT_IO_SPACE_MAX 65536
 #define NR_MAP 8
@@ -33,6 +34,11 @@ void* add_pio_map(ioaddr_t addr, size_t len, pio_callback_t callback) {
 	maps[nr_map].low = addr;
 	maps[nr_map].high = addr + len - 1;
 	maps[nr_map].callback = callback;
+
+	static char names[NR_MAP][16];
+	sprintf(names[nr_map], "pio-%04x", addr);
+	snapshot_register(names[nr_map], pio_space + addr, len);
+
 	nr_map ++;
 	return pio_space + addr;
 }
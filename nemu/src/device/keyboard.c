@@ -1,6 +1,7 @@
 #include "device/port-io.h"
 #include "device/i8259.h"
 #include "monitor/monitor.h"
+#include "monitor/snapshot.h"
 
 #define I8042_DATA_PORT 0x60
 #define KEYBOARD_IRQ 1
@@ -25,5 +26,6 @@ void i8042_io_handler(ioaddr_t addr, size_t len, bool is_write) {
 void init_i8042() {
 	i8042_data_port_base = add_pio_map(I8042_DATA_PORT, 1, i8042_io_handler);
 	newkey = false;
+	snapshot_register("i8042-newkey", &newkey, sizeof(newkey));
 }
 
@@ -6,6 +6,7 @@
 #include "device/port-io.h"
 #include "device/mmio.h"
 #include "device/i8259.h"
+#include "monitor/snapshot.h"
 
 enum {Horizontal_Total_Register, End_Horizontal_Display_Register, 
 	Start_Horizontal_Blanking_Register, End_Horizontal_Blanking_Register,
@@ -109,5 +110,6 @@ void init_vga() {
 	vga_dac_port_base = add_pio_map(VGA_DAC_WRITE_INDEX, 2, vga_dac_io_handler);
 	vga_crtc_port_base = add_pio_map(VGA_CRTC_INDEX, 2, vga_crtc_io_handler);
 	vmem_base = add_mmio_map(0xa0000, 0x20000, vga_vmem_io_handler);
+	snapshot_register("vga-crtc", vga_crtc_regs, sizeof(vga_crtc_regs));
 }
 #endif	/* HAS_DEVICE */
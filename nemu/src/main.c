@@ -1,7 +1,15 @@
+#include "common.h"
+
 void init_monitor(int, char *[]);
 void reg_test();
 void restart();
 void ui_mainloop();
+void cpu_exec(uint32_t);
+int finish_monitor();
+int run_jobs();
+
+extern bool batch_mode;
+extern int nr_job_thread;
 
 int main(int argc, char *argv[]) {
 
@@ -11,11 +19,23 @@ int main(int argc, char *argv[]) {
 	/* Test the implementation of the `CPU_state' structure. */
 	reg_test();
 
+	if(nr_job_thread > 0) {
+		/* Run the programs on a pool of threads. */
+		return run_jobs();
+	}
+
 	/* Initialize the virtual computer system. */
 	restart();
 
-	/* Receive commands from user. */
-	ui_mainloop();
+	if(batch_mode) {
+		/* Run the program to the end. */
+		cpu_exec(-1);
+	}
+	else {
+		/* Receive commands from user. */
+		ui_mainloop();
+	}
 
-	return 0;
+	/* Report what the monitor collected during execution. */
+	return finish_monitor();
 }
@@ -1,7 +1,11 @@
 #include "common.h"
+#include "memory/memory.h"
 #include "burst.h"
 #include "misc.h"
 
+#include <stdlib.h>
+#include <sys/mman.h>
+
 /* Simulate the (main) behavor of DRAM.
  * Although this will lower the performace of NEMU, it makes
  * you clear about how DRAM perform read/write operations.
@@ -29,10 +33,13 @@ typedef union {
 #define NR_BANK (1 << BANK_WIDTH)
 #define NR_RANK (1 << RANK_WIDTH)
 
-#define HW_MEM_SIZE (1 << (COL_WIDTH + ROW_WIDTH + BANK_WIDTH + RANK_WIDTH))
+/* The memory of the machine run by the current thread, allocated by
+ * new_dram() and set by init_dram().
+ */
+static __thread uint8_t (*dram)[NR_BANK][NR_ROW][NR_COL];
+__thread uint8_t *hw_mem;
 
-uint8_t dram[NR_RANK][NR_BANK][NR_ROW][NR_COL];
-uint8_t *hw_mem = (void *)dram;
+int dram_page_mode = DRAM_SMALL_PAGES;
 
 typedef struct {
 	uint8_t buf[NR_COL];
@@ -40,9 +47,13 @@ typedef struct {
 	bool valid;
 } RB;
 
-RB rowbufs[NR_RANK][NR_BANK];
+static __thread RB rowbufs[NR_RANK][NR_BANK];
 
-void init_ddr3() {
+/* The row buffers are written through, so they can be dropped any time,
+ * e.g. when the memory is replaced by a snapshot. They are not saved in
+ * snapshots and checkpoints.
+ */
+void invalidate_rowbufs() {
 	int i, j;
 	for(i = 0; i < NR_RANK; i ++) {
 		for(j = 0; j < NR_BANK; j ++) {
@@ -51,6 +62,121 @@ void init_ddr3() {
 	}
 }
 
+/* Allocate the memory of a machine. The host pages are allocated only
+ * when they are touched by the guest, and they are not charged to the
+ * swap space, so many idle machines cost little.
+ */
+void* new_dram() {
+	int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE;
+	void *mem = MAP_FAILED;
+
+	if(dram_page_mode == DRAM_HUGETLB) {
+		/* Reserve the huge pages now, otherwise the guest would be
+		 * killed when the host runs out of them.
+		 */
+		mem = mmap(NULL, HW_MEM_SIZE, PROT_READ | PROT_WRITE, (flags & ~MAP_NORESERVE) | MAP_HUGETLB, -1, 0);
+		if(mem == MAP_FAILED) {
+			Log("No huge pages are reserved in the host, use small pages instead");
+		}
+	}
+
+	if(mem == MAP_FAILED) {
+		mem = mmap(NULL, HW_MEM_SIZE, PROT_READ | PROT_WRITE, flags, -1, 0);
+		Assert(mem != MAP_FAILED, "Can not allocate the memory of the machine");
+		if(dram_page_mode == DRAM_THP) {
+			madvise(mem, HW_MEM_SIZE, MADV_HUGEPAGE);
+		}
+	}
+
+	return mem;
+}
+
+void free_dram(void *mem) {
+	munmap(mem, HW_MEM_SIZE);
+}
+
+/* Return the number of bytes of the memory of the current machine which
+ * belong to it in the host: the anonymous pages written by the machine,
+ * including the copies of the pages of the mapped files. The zero page
+ * shared by the pages only read, and the page cache of the mapped files,
+ * are not counted. Read from /proc/self/smaps, 0 if unavailable.
+ */
+size_t dram_resident() {
+	FILE *fp = fopen("/proc/self/smaps", "r");
+	if(fp == NULL) { return 0; }
+
+	uintptr_t lo = (uintptr_t)hw_mem, hi = lo + HW_MEM_SIZE;
+	bool in_range = false;
+	size_t kb = 0;
+	char line[512];
+	while(fgets(line, sizeof(line), fp) != NULL) {
+		unsigned long start, end, n;
+		if(sscanf(line, "%lx-%lx ", &start, &end) == 2) {
+			in_range = (start >= lo && end <= hi);
+		}
+		else if(in_range && (sscanf(line, "Anonymous: %lu kB", &n) == 1 ||
+					sscanf(line, "Private_Hugetlb: %lu kB", &n) == 1)) {
+			kb += n;
+		}
+	}
+	fclose(fp);
+	return kb * 1024;
+}
+
+/* Set the bits in `map' of the pages of the memory which may be non-zero:
+ * the pages the host has allocated or swapped out (from /proc/self/pagemap),
+ * and the pages of the files mapped into the memory (from /proc/self/maps).
+ * The other pages have never been touched, so looking at them would only
+ * map the zero page into them. Return false if it can not be found out.
+ */
+bool dram_used_pages(uint8_t *map) {
+	const int nr_page = HW_MEM_SIZE / 4096;
+	uintptr_t lo = (uintptr_t)hw_mem, hi = lo + HW_MEM_SIZE;
+	int i;
+
+	FILE *fp = fopen("/proc/self/pagemap", "rb");
+	if(fp == NULL) { return false; }
+	uint64_t *entries = malloc(sizeof(uint64_t) * nr_page);
+	assert(entries);
+	bool ok = (fseek(fp, (lo / 4096) * sizeof(uint64_t), SEEK_SET) == 0 &&
+			fread(entries, sizeof(uint64_t), nr_page, fp) == nr_page);
+	fclose(fp);
+
+	memset(map, 0, nr_page / 8);
+	for(i = 0; ok && i < nr_page; i ++) {
+		/* bit 63: present, bit 62: swapped */
+		if(entries[i] >> 62) { map[i / 8] |= 1 << (i % 8); }
+	}
+	free(entries);
+	if(!ok) { return false; }
+
+	fp = fopen("/proc/self/maps", "r");
+	if(fp == NULL) { return false; }
+	char line[512];
+	while(fgets(line, sizeof(line), fp) != NULL) {
+		unsigned long start, end, inode;
+		if(sscanf(line, "%lx-%lx %*s %*s %*s %lu", &start, &end, &inode) == 3 &&
+				inode != 0 && start >= lo && end <= hi) {
+			for(i = (start - lo) / 4096; i < (end - lo) / 4096; i ++) { map[i / 8] |= 1 << (i % 8); }
+		}
+	}
+	fclose(fp);
+	return true;
+}
+
+void init_ddr3() {
+	init_dram(new_dram());
+}
+
+/* Use `mem' of HW_MEM_SIZE bytes as the memory of the machine run by
+ * the current thread.
+ */
+void init_dram(void *mem) {
+	dram = mem;
+	hw_mem = mem;
+	invalidate_rowbufs();
+}
+
 static void ddr3_read(hwaddr_t addr, void *data) {
 	Assert(addr < HW_MEM_SIZE, "physical address %x is outside of the physical memory!", addr);
 
@@ -1,7 +1,16 @@
-#include "common.h"
+#include "nemu.h"
+#include "memory/mmu.h"
+#include "monitor/watchpoint.h"
+#include "monitor/checkpoint.h"
 
 uint32_t dram_read(hwaddr_t, size_t);
 void dram_write(hwaddr_t, size_t, uint32_t);
+void trace_mem_write(swaddr_t, size_t, uint32_t);
+
+extern bool trace_mem_enabled;
+
+__thread FetchWindow fetch_window;
+__thread uint8_t code_page_map[HW_MEM_SIZE >> (CODE_PAGE_SHIFT + 3)];
 
 /* Memory accessing interfaces */
 
@@ -10,28 +19,138 @@ uint32_t hwaddr_read(hwaddr_t addr, size_t len) {
 }
 
 void hwaddr_write(hwaddr_t addr, size_t len, uint32_t data) {
+	if(ckpt_enabled) {
+		if(!ckpt_page_dirty(addr)) { ckpt_save_page(addr); }
+		if(!ckpt_page_dirty(addr + len - 1)) { ckpt_save_page(addr + len - 1); }
+	}
+	if(code_page_set(addr) || code_page_set(addr + len - 1)) { code_page_write(addr, len); }
 	dram_write(addr, len, data);
 }
 
 uint32_t lnaddr_read(lnaddr_t addr, size_t len) {
+	if(cpu.cr0.paging) {
+		uint32_t offset = addr & PAGE_MASK;
+		if(offset + len > PAGE_SIZE) {
+			/* data cross the page boundary */
+			size_t len1 = PAGE_SIZE - offset;
+			uint32_t lo = hwaddr_read(page_translate(addr, false), len1);
+			uint32_t hi = hwaddr_read(page_translate(addr + len1, false), len - len1);
+			return lo | (hi << (len1 << 3));
+		}
+		addr = page_translate(addr, false);
+	}
 	return hwaddr_read(addr, len);
 }
 
 void lnaddr_write(lnaddr_t addr, size_t len, uint32_t data) {
+	if(cpu.cr0.paging) {
+		uint32_t offset = addr & PAGE_MASK;
+		if(offset + len > PAGE_SIZE) {
+			/* data cross the page boundary */
+			size_t len1 = PAGE_SIZE - offset;
+			hwaddr_write(page_translate(addr, true), len1, data);
+			hwaddr_write(page_translate(addr + len1, true), len - len1, data >> (len1 << 3));
+			return;
+		}
+		addr = page_translate(addr, true);
+	}
 	hwaddr_write(addr, len, data);
 }
 
+static inline lnaddr_t seg_translate(swaddr_t addr, size_t len, uint8_t sreg) {
+	SegReg *s = &cpu.sreg[sreg];
+	if(s->flat) { return addr; }
+	Assert(addr <= s->limit && len - 1 <= s->limit - addr,
+			"eip = 0x%08x: 0x%08x is beyond the limit of %%%s", cpu.eip, addr, sregs[sreg]);
+	return s->base + addr;
+}
+
 uint32_t swaddr_read(swaddr_t addr, size_t len) {
 #ifdef DEBUG
 	assert(len == 1 || len == 2 || len == 4);
 #endif
-	return lnaddr_read(addr, len);
+	return lnaddr_read(seg_translate(addr, len, current_sreg), len);
 }
 
 void swaddr_write(swaddr_t addr, size_t len, uint32_t data) {
 #ifdef DEBUG
 	assert(len == 1 || len == 2 || len == 4);
 #endif
-	lnaddr_write(addr, len, data);
+	if(trace_mem_enabled) { trace_mem_write(addr, len, data); }
+	if(wp_page_watched(addr) || wp_page_watched(addr + len - 1)) { wp_mem_write(addr, len); }
+	lnaddr_write(seg_translate(addr, len, current_sreg), len, data);
+}
+
+uint32_t instr_read(swaddr_t addr, size_t len) {
+	return lnaddr_read(seg_translate(addr, len, R_CS), len);
+}
+
+/* Move the fetch window to the page containing `addr', and read the
+ * code from it. The code crossing a page boundary is read piecewise.
+ */
+uint32_t instr_fetch_refill(swaddr_t addr, size_t len) {
+	SegReg *cs = &cpu.sreg[R_CS];
+	if(!cs->flat && addr > cs->limit) { return instr_read(addr, len); }
+
+	lnaddr_t lnaddr = cs->base + addr;
+	hwaddr_t hwaddr = (cpu.cr0.paging ? page_translate(lnaddr, false) : lnaddr);
+	if(hwaddr >= HW_MEM_SIZE) { return instr_read(addr, len); }
+
+	uint32_t size = PAGE_SIZE - (lnaddr & PAGE_MASK);
+	if(!cs->flat && size - 1 > cs->limit - addr) { size = cs->limit - addr + 1; }
+
+	FetchWindow *w = &fetch_window;
+	w->start = addr;
+	w->end = addr + size;
+	if(w->end < w->start) { w->end = 0xffffffff; }	/* wrapped around */
+	w->host = hw_mem + hwaddr;
+	w->hw_start = hwaddr;
+	w->hw_end = hwaddr + size;
+
+	uint32_t idx = hwaddr >> CODE_PAGE_SHIFT;
+	code_page_map[idx >> 3] |= 1 << (idx & 0x7);
+
+	if(addr + len > w->end) { return instr_read(addr, len); }
+	uint32_t val = 0;
+	memcpy(&val, w->host, len);
+	return val;
 }
 
+/* Called when [addr, addr + len) is written and a page in it has code.
+ * The fetch window is only flushed if the write overlaps it. The other
+ * pages in the range are no longer code pages until instructions are
+ * fetched from them again.
+ */
+void code_page_write(hwaddr_t addr, size_t len) {
+	FetchWindow *w = &fetch_window;
+	if(addr < w->hw_end && addr + len > w->hw_start) { fetch_window_flush(); }
+
+	uint32_t live = (w->hw_end > w->hw_start ? w->hw_start >> CODE_PAGE_SHIFT : -1);
+	uint32_t idx;
+	for(idx = addr >> CODE_PAGE_SHIFT; idx <= (addr + len - 1) >> CODE_PAGE_SHIFT; idx ++) {
+		if(idx != live && idx < (HW_MEM_SIZE >> CODE_PAGE_SHIFT)) {
+			code_page_map[idx >> 3] &= ~(1 << (idx & 0x7));
+		}
+	}
+}
+
+/* Whether the monitor can read `len' bytes at `addr' in the segment
+ * `sreg' without triggering an error in the memory system.
+ */
+bool swaddr_valid(swaddr_t addr, size_t len, uint8_t sreg) {
+	SegReg *s = &cpu.sreg[sreg];
+	if(addr + len - 1 < addr) { return false; }
+	if(!s->flat) {
+		if(addr + len - 1 > s->limit) { return false; }
+		addr += s->base;
+	}
+
+	lnaddr_t ends[2] = { addr, addr + len - 1 };
+	int i;
+	for(i = 0; i < 2; i ++) {
+		hwaddr_t hwaddr = ends[i];
+		if(cpu.cr0.paging && !page_probe(ends[i], &hwaddr)) { return false; }
+		if(hwaddr >= HW_MEM_SIZE) { return false; }
+	}
+	return true;
+}
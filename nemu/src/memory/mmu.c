@@ -0,0 +1,196 @@
+#include "nemu.h"
+#include "memory/mmu.h"
+
+/* The page walker and the TLB. 4KB pages and 4MB pages are cached in
+ * two direct-mapped TLBs. With 4MB pages, 32 entries cover the whole
+ * physical memory mapped by the kernel. The TLB is only valid while
+ * paging is enabled.
+ *
+ * Each entry is tagged with the address space it was filled in. Writing
+ * CR3 starts a new address space, which drops all entries at once except
+ * the global ones (G bit set with CR4.PGE), so the kernel mappings shared
+ * by all address spaces survive. Writing the other control registers, or
+ * replacing the machine state, flushes the whole TLB.
+ */
+
+#define NR_TLB 64
+#define NR_LARGE_TLB 32
+#define NR_PDE_CACHE 16
+
+typedef struct {
+	uint32_t tag;		/* the virtual page number, or -1 if invalid */
+	uint32_t space;		/* the address space, or GLOBAL_SPACE */
+	hwaddr_t frame;
+	bool dirty;			/* whether the D bit is set in the page tables */
+} TLB_entry;
+
+static __thread TLB_entry tlb[NR_TLB];
+static __thread TLB_entry large_tlb[NR_LARGE_TLB];
+static __thread uint32_t cur_space = 1;
+
+/* The PDEs used by recent walks, tagged with the directory index and the
+ * address space like the TLB, so that a miss in the TLB for 4KB pages
+ * costs only one read of the page tables.
+ */
+typedef struct {
+	uint32_t dir;		/* the directory index, or -1 if invalid */
+	uint32_t space;
+	PDE pde;
+} PDE_cache_entry;
+
+static __thread PDE_cache_entry pde_cache[NR_PDE_CACHE];
+
+static __thread struct {
+	uint64_t walk, large_walk;
+	uint64_t pde_hit, pde_miss;
+	uint64_t ad_update;
+} mmu_stat;
+
+#define INVALID_TAG (~0u)
+#define GLOBAL_SPACE 0
+
+/* The kernel mapping at 0xc0000000 and the identity mapping at 0 would
+ * share the slots of the large TLB if indexed by the low bits only.
+ */
+#define large_tlb_idx(dir) (((dir) ^ ((dir) >> 5)) % NR_LARGE_TLB)
+
+#define tlb_hit(e, t) ((e)->tag == (t) && ((e)->space == cur_space || (e)->space == GLOBAL_SPACE))
+
+void tlb_flush() {
+	int i;
+	for(i = 0; i < NR_TLB; i ++) { tlb[i].tag = INVALID_TAG; }
+	for(i = 0; i < NR_LARGE_TLB; i ++) { large_tlb[i].tag = INVALID_TAG; }
+	for(i = 0; i < NR_PDE_CACHE; i ++) { pde_cache[i].dir = INVALID_TAG; }
+	cur_space = 1;
+	fetch_window_flush();
+}
+
+/* Called when CR3 is written. */
+void tlb_switch_space() {
+	fetch_window_flush();
+	cur_space ++;
+	if(cur_space == GLOBAL_SPACE) {
+		/* wrapped around, the old tags can not be told apart */
+		tlb_flush();
+	}
+}
+
+static PDE read_pde(lnaddr_t addr) {
+	uint32_t dir = addr >> 22;
+	PDE_cache_entry *c = &pde_cache[dir % NR_PDE_CACHE];
+	if(c->dir == dir && c->space == cur_space) {
+		mmu_stat.pde_hit ++;
+		return c->pde;
+	}
+	mmu_stat.pde_miss ++;
+
+	hwaddr_t pde_addr = (cpu.cr3.page_directory_base << 12) + dir * sizeof(PDE);
+	PDE pde;
+	pde.val = hwaddr_read(pde_addr, 4);
+	Assert(pde.present, "eip = 0x%08x: page directory entry of 0x%08x is not present", cpu.eip, addr);
+
+	/* Set the A bit only when it is clear, then the cached PDE has it. */
+	if(!pde.accessed) {
+		pde.accessed = 1;
+		hwaddr_write(pde_addr, 4, pde.val);
+		mmu_stat.ad_update ++;
+	}
+
+	c->dir = dir;
+	c->space = cur_space;
+	c->pde = pde;
+	return pde;
+}
+
+/* Walk the page tables, and cache the translation into the TLB. */
+static hwaddr_t page_walk(lnaddr_t addr, bool is_write) {
+	mmu_stat.walk ++;
+	PDE pde = read_pde(addr);
+
+	if(pde.page_size && cpu.cr4.page_size_extensions) {
+		mmu_stat.large_walk ++;
+		uint32_t dir = addr >> 22;
+		if(is_write && !pde.dirty) {
+			pde.dirty = 1;
+			hwaddr_write((cpu.cr3.page_directory_base << 12) + dir * sizeof(PDE), 4, pde.val);
+			pde_cache[dir % NR_PDE_CACHE].pde = pde;
+			mmu_stat.ad_update ++;
+		}
+
+		TLB_entry *e = &large_tlb[large_tlb_idx(dir)];
+		e->tag = dir;
+		e->space = (pde.global && cpu.cr4.page_global_enable ? GLOBAL_SPACE : cur_space);
+		e->frame = pde.val & ~LARGE_PAGE_MASK;
+		e->dirty = pde.dirty;
+		return e->frame | (addr & LARGE_PAGE_MASK);
+	}
+
+	PTE pte;
+	hwaddr_t pte_addr = (pde.page_frame << 12) + ((addr >> 12) & (NR_PTE - 1)) * sizeof(PTE);
+	pte.val = hwaddr_read(pte_addr, 4);
+	Assert(pte.present, "eip = 0x%08x: page table entry of 0x%08x is not present", cpu.eip, addr);
+
+	if(!pte.accessed || (is_write && !pte.dirty)) {
+		pte.accessed = 1;
+		if(is_write) { pte.dirty = 1; }
+		hwaddr_write(pte_addr, 4, pte.val);
+		mmu_stat.ad_update ++;
+	}
+
+	TLB_entry *e = &tlb[(addr >> 12) % NR_TLB];
+	e->tag = addr >> 12;
+	e->space = (pte.global && cpu.cr4.page_global_enable ? GLOBAL_SPACE : cur_space);
+	e->frame = pte.page_frame << 12;
+	e->dirty = pte.dirty;
+	return e->frame | (addr & PAGE_MASK);
+}
+
+/* The A bit is always set for the pages in the TLB. A write to a page
+ * whose D bit is clear walks the page tables again to set it.
+ */
+hwaddr_t page_translate(lnaddr_t addr, bool is_write) {
+	TLB_entry *e = &large_tlb[large_tlb_idx(addr >> 22)];
+	if(tlb_hit(e, addr >> 22) && (e->dirty || !is_write)) {
+		return e->frame | (addr & LARGE_PAGE_MASK);
+	}
+
+	e = &tlb[(addr >> 12) % NR_TLB];
+	if(tlb_hit(e, addr >> 12) && (e->dirty || !is_write)) {
+		return e->frame | (addr & PAGE_MASK);
+	}
+
+	return page_walk(addr, is_write);
+}
+
+void mmu_report() {
+	uint64_t nr_pde = mmu_stat.pde_hit + mmu_stat.pde_miss;
+	printf("%llu page walks, %llu of them for 4MB pages\n",
+			(unsigned long long)mmu_stat.walk, (unsigned long long)mmu_stat.large_walk);
+	printf("PDE cache: %llu hits, %llu misses, hit rate %.1f%%\n",
+			(unsigned long long)mmu_stat.pde_hit, (unsigned long long)mmu_stat.pde_miss,
+			nr_pde == 0 ? 0.0 : 100.0 * mmu_stat.pde_hit / nr_pde);
+	printf("%llu writes to the page tables for the A/D bits\n", (unsigned long long)mmu_stat.ad_update);
+}
+
+/* Translate the linear address for the monitor, without touching the
+ * TLB. Return false instead of failing if the page is not present.
+ */
+bool page_probe(lnaddr_t addr, hwaddr_t *res) {
+	PDE pde;
+	PTE pte;
+	hwaddr_t pdir = cpu.cr3.page_directory_base << 12;
+
+	if(pdir >= HW_MEM_SIZE) { return false; }
+	pde.val = hwaddr_read(pdir + (addr >> 22) * sizeof(PDE), 4);
+	if(!pde.present) { return false; }
+	if(pde.page_size && cpu.cr4.page_size_extensions) {
+		*res = (pde.val & ~LARGE_PAGE_MASK) | (addr & LARGE_PAGE_MASK);
+		return true;
+	}
+
+	if((pde.page_frame << 12) >= HW_MEM_SIZE) { return false; }
+	pte.val = hwaddr_read((pde.page_frame << 12) + ((addr >> 12) & (NR_PTE - 1)) * sizeof(PTE), 4);
+	if(!pte.present) { return false; }
+	*res = (pte.page_frame << 12) | (addr & PAGE_MASK);
+	return true;
+}
@@ -0,0 +1,124 @@
+#include "nemu.h"
+#include "monitor/monitor.h"
+#include "../../lib-common/trap.h"
+
+#include <stdlib.h>
+#include <pthread.h>
+#include <time.h>
+
+/* Run many programs concurrently in one NEMU process, `nr_job_thread'
+ * of them at a time. The state of the machine (CPU, memory, row buffers
+ * and execution state) is thread-local, so each thread of the pool runs
+ * its own machine with its own memory. The monitor (watchpoints,
+ * breakpoints, trace, profile, checkpoints) belongs to the main thread
+ * and is not available to the jobs.
+ */
+
+typedef struct {
+	char *file;
+	bool good;
+	uint64_t nr_instr;
+	double time;
+	size_t resident;
+} Job;
+
+int nr_job_thread = 0;
+
+static Job *jobs;
+static int nr_job;
+static int next_job = 0;
+
+void load_program(const char *);
+void cpu_exec(uint32_t);
+void opcode_stat_merge();
+void opcode_stat_report();
+
+void set_jobs(int argc, char *argv[]) {
+	if(argc == 0) {
+		printf("No program to run\n");
+		exit(1);
+	}
+
+	nr_job = argc;
+	jobs = calloc(nr_job, sizeof(Job));
+	assert(jobs);
+
+	int i;
+	for(i = 0; i < nr_job; i ++) { jobs[i].file = argv[i]; }
+}
+
+static double now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void run_job(Job *job) {
+	/* A fresh machine for each job. */
+	void *mem = new_dram();
+	init_dram(mem);
+	memset(&cpu, 0, sizeof(cpu));
+	nemu_state = STOP;
+	nr_instr = 0;
+
+	double start = now();
+	load_program(job->file);
+	cpu_exec(-1);
+
+	job->time = now() - start;
+	job->nr_instr = nr_instr;
+	job->good = (nemu_state == END && cpu.eax == NEMU_HC_GOOD_TRAP);
+	job->resident = dram_resident();
+#ifdef OPCODE_STAT
+	opcode_stat_merge();
+#endif
+
+	free_dram(mem);
+}
+
+static void* job_thread(void *arg) {
+	int i;
+	while((i = __sync_fetch_and_add(&next_job, 1)) < nr_job) {
+		run_job(&jobs[i]);
+	}
+	return NULL;
+}
+
+/* Run all jobs, and return 0 only if all of them hit the good trap. */
+int run_jobs() {
+	int nr_thread = (nr_job_thread < nr_job ? nr_job_thread : nr_job);
+	pthread_t *threads = malloc(sizeof(pthread_t) * nr_thread);
+	assert(threads);
+
+	double start = now();
+	int i, ret;
+	for(i = 0; i < nr_thread; i ++) {
+		ret = pthread_create(&threads[i], NULL, job_thread, NULL);
+		Assert(ret == 0, "Can not create the job threads");
+	}
+	for(i = 0; i < nr_thread; i ++) {
+		pthread_join(threads[i], NULL);
+	}
+	double total = now() - start;
+	free(threads);
+
+	int nr_bad = 0;
+	uint64_t total_instr = 0;
+	printf("%-6s %14s %10s %10s  %s\n", "result", "instructions", "time(s)", "mem(KB)", "program");
+	for(i = 0; i < nr_job; i ++) {
+		Job *job = &jobs[i];
+		printf("%-6s %14llu %10.3f %10zu  %s\n", job->good ? "GOOD" : "BAD",
+				(unsigned long long)job->nr_instr, job->time, job->resident / 1024, job->file);
+		if(!job->good) { nr_bad ++; }
+		total_instr += job->nr_instr;
+	}
+	printf("%d/%d programs hit the good trap, %llu instructions in %.3f s on %d threads\n",
+			nr_job - nr_bad, nr_job, (unsigned long long)total_instr, total, nr_thread);
+
+#ifdef OPCODE_STAT
+	/* for all jobs */
+	opcode_stat_report();
+#endif
+
+	return (nr_bad == 0 ? 0 : 1);
+}
@@ -0,0 +1,246 @@
+#include "nemu.h"
+#include "monitor/monitor.h"
+#include "monitor/snapshot.h"
+#include "monitor/checkpoint.h"
+
+#include <stdlib.h>
+
+/* Incremental checkpoints for reverse execution. A checkpoint is taken
+ * every `ckpt_interval' instructions, and the latest NR_CKPT ones are
+ * kept in a ring. Each checkpoint holds the registered machine state
+ * (see snapshot.c) and the contents at the checkpoint of the pages
+ * written before the next checkpoint. Undoing the pages from the latest
+ * checkpoint backwards restores the memory at any checkpoint, and the
+ * execution is then replayed deterministically to the target instruction.
+ */
+
+#define NR_CKPT 64
+#define PAGE_SIZE (1 << CKPT_PAGE_SHIFT)
+
+typedef struct {
+	uint64_t nr_instr;
+	uint8_t *state;
+
+	/* the pages written after this checkpoint, with their old contents */
+	uint32_t *page_idx;
+	uint8_t *pages;
+	int nr_page, max_page;
+} Checkpoint;
+
+static Checkpoint ckpts[NR_CKPT];
+static int first_ckpt, nr_ckpt;		/* the ring */
+static uint32_t ckpt_interval;
+
+bool ckpt_enabled = false;
+uint8_t ckpt_dirty_map[1 << (32 - CKPT_PAGE_SHIFT - 3)];
+bool replaying = false;
+uint64_t next_ckpt = -1;
+
+void reset_watchpoints();
+void cpu_exec(uint32_t);
+
+#define ckpt(i) (&ckpts[(first_ckpt + (i)) % NR_CKPT])
+#define latest_ckpt() ckpt(nr_ckpt - 1)
+
+static void clear_dirty_map() {
+	memset(ckpt_dirty_map, 0, HW_MEM_SIZE >> (CKPT_PAGE_SHIFT + 3));
+}
+
+static void free_ckpt(Checkpoint *c) {
+	free(c->state);
+	free(c->page_idx);
+	free(c->pages);
+	memset(c, 0, sizeof(*c));
+}
+
+/* Called by hwaddr_write() before the page containing `addr' is first
+ * written after the latest checkpoint.
+ */
+void ckpt_save_page(hwaddr_t addr) {
+	if(addr >= HW_MEM_SIZE) { return; }
+
+	Checkpoint *c = latest_ckpt();
+	uint32_t idx = addr >> CKPT_PAGE_SHIFT;
+
+	if(c->nr_page == c->max_page) {
+		c->max_page = (c->max_page == 0 ? 16 : c->max_page * 2);
+		c->page_idx = realloc(c->page_idx, sizeof(uint32_t) * c->max_page);
+		c->pages = realloc(c->pages, (size_t)PAGE_SIZE * c->max_page);
+		assert(c->page_idx && c->pages);
+	}
+	c->page_idx[c->nr_page] = idx;
+	memcpy(c->pages + (size_t)PAGE_SIZE * c->nr_page, hw_mem + (size_t)idx * PAGE_SIZE, PAGE_SIZE);
+	c->nr_page ++;
+
+	ckpt_dirty_map[idx >> 3] |= 1 << (idx & 0x7);
+}
+
+void take_checkpoint() {
+	if(nr_ckpt == NR_CKPT) {
+		free_ckpt(ckpt(0));
+		first_ckpt = (first_ckpt + 1) % NR_CKPT;
+		nr_ckpt --;
+	}
+
+	nr_ckpt ++;
+	Checkpoint *c = latest_ckpt();
+	c->nr_instr = nr_instr;
+	c->state = malloc(snapshot_state_size());
+	assert(c->state);
+	snapshot_save_state(c->state);
+
+	clear_dirty_map();
+	next_ckpt = nr_instr + ckpt_interval;
+}
+
+static void drop_checkpoints() {
+	while(nr_ckpt > 0) {
+		free_ckpt(latest_ckpt());
+		nr_ckpt --;
+	}
+	first_ckpt = 0;
+}
+
+void start_checkpoints(uint32_t interval) {
+	assert(interval > 0);
+	drop_checkpoints();
+	ckpt_interval = interval;
+	ckpt_enabled = true;
+	take_checkpoint();
+}
+
+void stop_checkpoints() {
+	drop_checkpoints();
+	ckpt_enabled = false;
+	next_ckpt = -1;
+}
+
+/* Called when the whole machine state is replaced, e.g. by loadvm. */
+void reset_checkpoints() {
+	if(ckpt_enabled) {
+		drop_checkpoints();
+		take_checkpoint();
+	}
+}
+
+/* Go back to checkpoint `k', and drop all checkpoints after it. */
+static void restore_checkpoint(int k) {
+	int i, j;
+	for(i = nr_ckpt - 1; i >= k; i --) {
+		Checkpoint *c = ckpt(i);
+		/* undo in the reverse order, in case of duplicated pages */
+		for(j = c->nr_page - 1; j >= 0; j --) {
+			memcpy(hw_mem + (size_t)c->page_idx[j] * PAGE_SIZE, c->pages + (size_t)PAGE_SIZE * j, PAGE_SIZE);
+		}
+		if(i > k) {
+			free_ckpt(c);
+			nr_ckpt --;
+		}
+	}
+
+	Checkpoint *c = ckpt(k);
+	c->nr_page = 0;
+	snapshot_load_state(c->state);
+	nr_instr = c->nr_instr;
+	next_ckpt = nr_instr + ckpt_interval;
+	clear_dirty_map();
+
+	nemu_state = STOP;
+	reset_watchpoints();
+}
+
+/* Return the latest checkpoint not after instruction `target', or -1. */
+static int find_checkpoint(uint64_t target) {
+	int k;
+	for(k = nr_ckpt - 1; k >= 0 && ckpt(k)->nr_instr > target; k --);
+	return k;
+}
+
+/* Run silently until instruction `target'. Return the last instruction
+ * before `target' where a breakpoint or a watchpoint stopped the
+ * execution, or -1 if none.
+ */
+static uint64_t replay(uint64_t target) {
+	uint64_t last_stop = -1;
+	replaying = true;
+	while(nr_instr < target && nemu_state != END) {
+		uint64_t n = target - nr_instr;
+		cpu_exec(n > 0x40000000 ? 0x40000000 : n);
+		if(nemu_state == STOP && nr_instr < target) { last_stop = nr_instr; }
+	}
+	replaying = false;
+	if(nemu_state != END) { nemu_state = STOP; }
+	return last_stop;
+}
+
+static bool check_enabled() {
+	if(!ckpt_enabled) {
+		printf("Reverse execution needs checkpoints, enable them with 'checkpoint N'\n");
+		return false;
+	}
+	return true;
+}
+
+/* Go back `n' instructions. */
+void reverse_step(uint64_t n) {
+	if(!check_enabled()) { return; }
+
+	uint64_t target = (n > nr_instr ? 0 : nr_instr - n);
+	int k = find_checkpoint(target);
+	if(k == -1) {
+		printf("Can not go back before instruction %llu, the oldest checkpoint\n",
+				(unsigned long long)ckpt(0)->nr_instr);
+		return;
+	}
+
+	restore_checkpoint(k);
+	replay(target);
+	printf("Instruction %llu, eip = 0x%08x\n", (unsigned long long)nr_instr, cpu.eip);
+}
+
+/* Go back to the last place where a breakpoint or a watchpoint stopped
+ * the execution. Search the intervals between checkpoints backwards.
+ */
+void reverse_continue() {
+	if(!check_enabled()) { return; }
+
+	uint64_t orig = nr_instr, end = orig;
+	int k;
+	for(k = find_checkpoint(end - 1); k >= 0; k --) {
+		if(end == 0) { break; }
+
+		restore_checkpoint(k);
+		uint64_t last_stop = replay(end);
+		if(last_stop != -1) {
+			restore_checkpoint(k);
+			replay(last_stop);
+			printf("Stopped at instruction %llu, eip = 0x%08x\n", (unsigned long long)nr_instr, cpu.eip);
+			return;
+		}
+
+		/* The checkpoints taken again by replay() are dropped when
+		 * going back to the previous checkpoint.
+		 */
+		end = ckpt(k)->nr_instr;
+	}
+
+	printf("No breakpoint or watchpoint is hit since instruction %llu\n",
+			(unsigned long long)ckpt(0)->nr_instr);
+
+	/* Return to where we were. */
+	restore_checkpoint(find_checkpoint(orig));
+	replay(orig);
+}
+
+void print_checkpoints() {
+	if(!ckpt_enabled) {
+		printf("Checkpoints are disabled.\n");
+		return;
+	}
+
+	int i;
+	size_t nr_page = 0;
+	for(i = 0; i < nr_ckpt; i ++) { nr_page += ckpt(i)->nr_page; }
+	printf("%d checkpoints every %u instructions, from instruction %llu, %zu pages saved\n",
+			nr_ckpt, ckpt_interval, (unsigned long long)ckpt(0)->nr_instr, nr_page);
+}
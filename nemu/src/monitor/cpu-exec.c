@@ -1,5 +1,9 @@
 #include "monitor/monitor.h"
 #include "cpu/helper.h"
+#include "cpu/decode/decode.h"
+#include "monitor/watchpoint.h"
+#include "monitor/breakpoint.h"
+#include "monitor/checkpoint.h"
 #include <setjmp.h>
 
 /* The assembly code of instructions executed is only output to the screen
@@ -9,15 +13,32 @@
  */
 #define MAX_INSTR_TO_PRINT 10
 
-int nemu_state = STOP;
+__thread int nemu_state = STOP;
+
+__thread uint64_t nr_instr = 0;
 
 int exec(swaddr_t);
+int exec_stat(swaddr_t);
+void profile_sample();
+void trace_instr(swaddr_t, int);
+
+extern uint64_t next_sample;
+extern bool trace_enabled;
 
-char assembly[80];
-char asm_buf[128];
+__thread char assembly[80];
+__thread char asm_buf[128];
+
+#ifdef DEBUG
+__thread bool asm_requested = false;
+
+/* Write the assembly code of every instruction executed into the log file.
+ * This slows down NEMU a lot, use the `trace' command for long runs.
+ */
+bool log_instr = false;
+#endif
 
 /* Used with exception handling. */
-jmp_buf jbuf;
+__thread jmp_buf jbuf;
 
 void print_bin_instr(swaddr_t eip, int len) {
 	int i;
@@ -42,6 +63,9 @@ void cpu_exec(volatile uint32_t n) {
 	}
 	nemu_state = RUNNING;
 
+	/* Do not stop at the breakpoint where the execution is resumed. */
+	uint64_t start_instr = nr_instr;
+
 #ifdef DEBUG
 	volatile uint32_t n_temp = n;
 #endif
@@ -49,31 +73,59 @@ void cpu_exec(volatile uint32_t n) {
 	setjmp(jbuf);
 
 	for(; n > 0; n --) {
-#ifdef DEBUG
 		swaddr_t eip_temp = cpu.eip;
+
+		if(bp_page_set(cpu.eip) && nr_instr != start_instr) {
+			int NO = find_bp(cpu.eip);
+			if(NO != -1) {
+				if(!replaying) { printf("\nBreakpoint %d at eip = 0x%08x\n", NO, cpu.eip); }
+				nemu_state = STOP;
+				return;
+			}
+		}
+#ifdef DEBUG
 		if((n & 0xffff) == 0) {
 			/* Output some dots while executing the program. */
 			fputc('.', stderr);
 		}
+
+		/* Only generate the assembly code which will be printed. */
+		asm_requested = !replaying && (n_temp < MAX_INSTR_TO_PRINT || log_instr);
 #endif
 
 		/* Execute one instruction, including instruction fetch,
 		 * instruction decode, and the actual execution. */
+#ifdef OPCODE_STAT
+		int instr_len = exec_stat(cpu.eip);
+#else
 		int instr_len = exec(cpu.eip);
+#endif
 
 		cpu.eip += instr_len;
+		nr_instr ++;
+
+		/* The next instruction accesses the data segment unless it says otherwise. */
+		current_sreg = R_DS;
+
+		if(nr_instr == next_sample) { profile_sample(); }
+		if(nr_instr == next_ckpt) { take_checkpoint(); }
+		if(trace_enabled) { trace_instr(eip_temp, instr_len); }
 
 #ifdef DEBUG
-		print_bin_instr(eip_temp, instr_len);
-		strcat(asm_buf, assembly);
-		Log_write("%s\n", asm_buf);
-		if(n_temp < MAX_INSTR_TO_PRINT) {
-			printf("%s\n", asm_buf);
+		if(asm_requested) {
+			print_bin_instr(eip_temp, instr_len);
+			strcat(asm_buf, get_asm());
+			Log_write("%s\n", asm_buf);
+			if(n_temp < MAX_INSTR_TO_PRINT) {
+				printf("%s\n", asm_buf);
+			}
 		}
 #endif
 
-		/* TODO: check watchpoints here. */
-
+		/* Only the watchpoints which may be changed are evaluated. */
+		if(wp_mem_hit || nr_eager_wp != 0) {
+			if(check_watchpoints()) { nemu_state = STOP; }
+		}
 
 #ifdef HAS_DEVICE
 		extern void device_update();
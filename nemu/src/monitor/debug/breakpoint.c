@@ -0,0 +1,105 @@
+#include "monitor/breakpoint.h"
+
+#define NR_BP 32
+#define BP_HASH_SIZE 64
+
+typedef struct {
+	int NO;
+	swaddr_t addr;
+	uint32_t hit;
+} BP;
+
+static BP bps[NR_BP];
+static int nr_bp = 0;
+static int next_NO = 0;
+
+/* open addressing hash table from addresses to indices of `bps' plus 1 */
+static uint8_t bp_hash[BP_HASH_SIZE];
+
+uint8_t bp_page_map[1 << (32 - BP_PAGE_SHIFT - 3)];
+
+static inline uint32_t hash_addr(swaddr_t addr) {
+	return (addr * 2654435761u) >> (32 - 6);
+}
+
+static void set_page(swaddr_t addr) {
+	bp_page_map[addr >> (BP_PAGE_SHIFT + 3)] |= 1 << ((addr >> BP_PAGE_SHIFT) & 0x7);
+}
+
+static void clear_page(swaddr_t addr) {
+	bp_page_map[addr >> (BP_PAGE_SHIFT + 3)] &= ~(1 << ((addr >> BP_PAGE_SHIFT) & 0x7));
+}
+
+static void rebuild_index() {
+	int i;
+	uint32_t h;
+	memset(bp_hash, 0, sizeof(bp_hash));
+	for(i = 0; i < nr_bp; i ++) {
+		for(h = hash_addr(bps[i].addr); bp_hash[h] != 0; h = (h + 1) % BP_HASH_SIZE);
+		bp_hash[h] = i + 1;
+		set_page(bps[i].addr);
+	}
+}
+
+/* Return the index of the breakpoint at `addr', or -1 if not found. */
+static int lookup(swaddr_t addr) {
+	uint32_t h;
+	for(h = hash_addr(addr); bp_hash[h] != 0; h = (h + 1) % BP_HASH_SIZE) {
+		if(bps[bp_hash[h] - 1].addr == addr) { return bp_hash[h] - 1; }
+	}
+	return -1;
+}
+
+/* Return the number of the new breakpoint, or -1 on failure. */
+int set_bp(swaddr_t addr) {
+	int i = lookup(addr);
+	if(i != -1) {
+		printf("Breakpoint %d is already at 0x%08x\n", bps[i].NO, addr);
+		return -1;
+	}
+	if(nr_bp == NR_BP) {
+		printf("Too many breakpoints\n");
+		return -1;
+	}
+
+	bps[nr_bp].NO = next_NO ++;
+	bps[nr_bp].addr = addr;
+	bps[nr_bp].hit = 0;
+	nr_bp ++;
+	rebuild_index();
+	return bps[nr_bp - 1].NO;
+}
+
+bool clear_bp(swaddr_t addr) {
+	int i = lookup(addr);
+	if(i == -1) { return false; }
+
+	bps[i] = bps[-- nr_bp];
+	/* Other breakpoints in the page set the bit again. */
+	clear_page(addr);
+	rebuild_index();
+	return true;
+}
+
+/* Called by cpu_exec() before executing an instruction in a page with
+ * breakpoints. Return the number of the breakpoint hit, or -1.
+ */
+int find_bp(swaddr_t addr) {
+	int i = lookup(addr);
+	if(i == -1) { return -1; }
+	bps[i].hit ++;
+	return bps[i].NO;
+}
+
+void print_bps() {
+	int i;
+	if(nr_bp == 0) {
+		printf("No breakpoints.\n");
+		return;
+	}
+
+	printf("Num  Address     Hits\n");
+	for(i = 0; i < nr_bp; i ++) {
+		printf("%-4d 0x%08x  %u\n", bps[i].NO, bps[i].addr, bps[i].hit);
+	}
+}
@@ -1,6 +1,12 @@
 #include "common.h"
+#include "monitor/symbol.h"
+#include "misc.h"
 #include <stdlib.h>
 #include <elf.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 char *exec_file = NULL;
 
@@ -8,20 +14,141 @@ static char *strtab = NULL;
 static Elf32_Sym *symtab = NULL;
 static int nr_symtab_entry;
 
+/* symbols sorted by their start addresses */
+static Symbol *syms = NULL;
+static int nr_sym;
+
+/* open addressing hash table from names to indices of `syms', 0 for empty */
+static int *sym_hash = NULL;
+static uint32_t sym_hash_size;
+
+/* bumped whenever the symbols are loaded */
+static uint32_t symtab_ver = 0;
+
+uint32_t symtab_version() {
+	return symtab_ver;
+}
+
+static int sym_cmp(const void *a, const void *b) {
+	const Symbol *x = a, *y = b;
+	if(x->start != y->start) { return (x->start > y->start) - (x->start < y->start); }
+	/* prefer functions to objects, and then the larger one */
+	if(x->is_func != y->is_func) { return y->is_func - x->is_func; }
+	return (x->end < y->end) - (x->end > y->end);
+}
+
+static void init_symbol_index() {
+	int i, j;
+	syms = malloc(sizeof(Symbol) * nr_symtab_entry);
+	assert(syms);
+	nr_sym = 0;
+	for(i = 0; i < nr_symtab_entry; i ++) {
+		int type = ELF32_ST_TYPE(symtab[i].st_info);
+		if((type == STT_FUNC || type == STT_OBJECT) && symtab[i].st_name != 0) {
+			syms[nr_sym].start = symtab[i].st_value;
+			syms[nr_sym].end = symtab[i].st_value + symtab[i].st_size;
+			syms[nr_sym].name = strtab + symtab[i].st_name;
+			syms[nr_sym].is_func = (type == STT_FUNC);
+			nr_sym ++;
+		}
+	}
+
+	qsort(syms, nr_sym, sizeof(Symbol), sym_cmp);
+
+	/* Drop aliases at the same address. Some symbols written in assembly
+	 * do not record their sizes, assume that they extend to the next one,
+	 * or cover one byte if they are the last one.
+	 * Cut overlapping ranges to keep the binary search correct.
+	 */
+	for(i = j = 0; i < nr_sym; i ++) {
+		if(j > 0 && syms[i].start == syms[j - 1].start) { continue; }
+		syms[j ++] = syms[i];
+	}
+	nr_sym = j;
+	for(i = 0; i + 1 < nr_sym; i ++) {
+		if(syms[i].end == syms[i].start || syms[i].end > syms[i + 1].start) {
+			syms[i].end = syms[i + 1].start;
+		}
+	}
+	if(nr_sym > 0 && syms[nr_sym - 1].end == syms[nr_sym - 1].start) {
+		syms[nr_sym - 1].end ++;
+	}
+
+	/* The hash table is built from the symbol table instead of `syms',
+	 * so that aliases can be looked up by name.
+	 */
+	for(sym_hash_size = 16; sym_hash_size < nr_symtab_entry * 2; sym_hash_size <<= 1);
+	sym_hash = calloc(sym_hash_size, sizeof(int));
+	assert(sym_hash);
+	for(i = 0; i < nr_symtab_entry; i ++) {
+		int type = ELF32_ST_TYPE(symtab[i].st_info);
+		if((type != STT_FUNC && type != STT_OBJECT) || symtab[i].st_name == 0) { continue; }
+
+		const char *name = strtab + symtab[i].st_name;
+		uint32_t h = hash_str(name) & (sym_hash_size - 1);
+		/* keep the first one if there are several local symbols with the same name */
+		while(sym_hash[h] != 0 && strcmp(strtab + symtab[sym_hash[h] - 1].st_name, name) != 0) {
+			h = (h + 1) & (sym_hash_size - 1);
+		}
+		if(sym_hash[h] == 0) { sym_hash[h] = i + 1; }
+	}
+}
+
+swaddr_t look_up_symtab(char *sym, bool *success) {
+	uint32_t h = hash_str(sym) & (sym_hash_size - 1);
+	for(; sym_hash[h] != 0; h = (h + 1) & (sym_hash_size - 1)) {
+		Elf32_Sym *s = &symtab[sym_hash[h] - 1];
+		if(strcmp(strtab + s->st_name, sym) == 0) {
+			*success = true;
+			return s->st_value;
+		}
+	}
+	*success = false;
+	return 0;
+}
+
+int find_symbol(swaddr_t addr) {
+	int l = 0, r = nr_sym - 1;
+	while(l <= r) {
+		int mid = (l + r) / 2;
+		if(addr < syms[mid].start) { r = mid - 1; }
+		else if(addr >= syms[mid].end) { l = mid + 1; }
+		else { return mid; }
+	}
+	return -1;
+}
+
+int get_nr_symbol() {
+	return nr_sym;
+}
+
+const Symbol* get_symbol(int idx) {
+	assert(idx >= 0 && idx < nr_sym);
+	return &syms[idx];
+}
+
 void load_elf_tables(int argc, char *argv[]) {
 	int ret;
-	Assert(argc == 2, "run NEMU with format 'nemu [program]'");
+	Assert(argc == 2, "run NEMU with format 'nemu [OPTION...] [program]'");
 	exec_file = argv[1];
-
-	FILE *fp = fopen(exec_file, "rb");
-	Assert(fp, "Can not open '%s'", exec_file);
-
-	uint8_t buf[sizeof(Elf32_Ehdr)];
-	ret = fread(buf, sizeof(Elf32_Ehdr), 1, fp);
-	assert(ret == 1);
+	symtab_ver ++;
+
+	/* Map the whole file. The symbol table and the string table are
+	 * used in place, so the mapping is kept.
+	 */
+	int fd = open(exec_file, O_RDONLY);
+	Assert(fd != -1, "Can not open '%s'", exec_file);
+	struct stat st;
+	ret = fstat(fd, &st);
+	assert(ret == 0);
+	size_t file_size = st.st_size;
+	Assert(file_size >= sizeof(Elf32_Ehdr), "'%s' is not an ELF file", exec_file);
+	uint8_t *file = mmap(NULL, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	assert(file != MAP_FAILED);
+	close(fd);
 
 	/* The first several bytes contain the ELF header. */
-	Elf32_Ehdr *elf = (void *)buf;
+	Elf32_Ehdr *elf = (void *)file;
 	char magic[] = {ELFMAG0, ELFMAG1, ELFMAG2, ELFMAG3};
 
 	/* Check ELF header */
@@ -37,47 +164,35 @@ void load_elf_tables(int argc, char *argv[]) {
 	assert(elf->e_version == EV_CURRENT);				// current version
 
 
-	/* Load symbol table and string table for future use */
+	/* Find symbol table and string table for future use */
 
-	/* Load section header table */
-	uint32_t sh_size = elf->e_shentsize * elf->e_shnum;
-	Elf32_Shdr *sh = malloc(sh_size);
-	fseek(fp, elf->e_shoff, SEEK_SET);
-	ret = fread(sh, sh_size, 1, fp);
-	assert(ret == 1);
+	/* Section header table */
+	assert(elf->e_shentsize == sizeof(Elf32_Shdr));
+	assert(elf->e_shoff + elf->e_shnum * sizeof(Elf32_Shdr) <= file_size);
+	Elf32_Shdr *sh = (void *)(file + elf->e_shoff);
 
-	/* Load section header string table */
-	char *shstrtab = malloc(sh[elf->e_shstrndx].sh_size);
-	fseek(fp, sh[elf->e_shstrndx].sh_offset, SEEK_SET);
-	ret = fread(shstrtab, sh[elf->e_shstrndx].sh_size, 1, fp);
-	assert(ret == 1);
+	/* Section header string table */
+	assert(sh[elf->e_shstrndx].sh_offset + sh[elf->e_shstrndx].sh_size <= file_size);
+	char *shstrtab = (void *)(file + sh[elf->e_shstrndx].sh_offset);
 
 	int i;
 	for(i = 0; i < elf->e_shnum; i ++) {
+		assert(sh[i].sh_type == SHT_NOBITS || sh[i].sh_offset + sh[i].sh_size <= file_size);
 		if(sh[i].sh_type == SHT_SYMTAB && 
 				strcmp(shstrtab + sh[i].sh_name, ".symtab") == 0) {
-			/* Load symbol table from exec_file */
-			symtab = malloc(sh[i].sh_size);
-			fseek(fp, sh[i].sh_offset, SEEK_SET);
-			ret = fread(symtab, sh[i].sh_size, 1, fp);
-			assert(ret == 1);
+			/* Symbol table in exec_file */
+			symtab = (void *)(file + sh[i].sh_offset);
 			nr_symtab_entry = sh[i].sh_size / sizeof(symtab[0]);
 		}
 		else if(sh[i].sh_type == SHT_STRTAB && 
 				strcmp(shstrtab + sh[i].sh_name, ".strtab") == 0) {
-			/* Load string table from exec_file */
-			strtab = malloc(sh[i].sh_size);
-			fseek(fp, sh[i].sh_offset, SEEK_SET);
-			ret = fread(strtab, sh[i].sh_size, 1, fp);
-			assert(ret == 1);
+			/* String table in exec_file */
+			strtab = (void *)(file + sh[i].sh_offset);
 		}
 	}
 
-	free(sh);
-	free(shstrtab);
-
 	assert(strtab != NULL && symtab != NULL);
 
-	fclose(fp);
+	/* Build the indices used by the debugger and the profiler. */
+	init_symbol_index();
 }
-
@@ -1,108 +1,450 @@
 #include "nemu.h"
+#include "monitor/expr.h"
+#include "monitor/symbol.h"
+#include "misc.h"
 
-/* We use the POSIX regex functions to process regular expressions.
- * Type 'man regex' for more information about POSIX regex functions.
+#include <stdlib.h>
+#include <ctype.h>
+
+/* Expressions are compiled into the code of a stack machine by a
+ * hand-written lexer and a precedence climbing parser. The operators
+ * are those of C, evaluated on 32-bit unsigned integers:
+ *
+ *   ?:  ||  &&  |  ^  &  == !=  < <= > >=  << >>  + -  * / %
+ *   unary - + ! ~ *(dereference, 4 bytes)
+ *
+ * Operands are numbers (decimal, octal or hexadecimal), registers like
+ * `$eax', `$ax', `$al' and `$eip', and symbols of the guest program.
  */
-#include <sys/types.h>
-#include <regex.h>
 
 enum {
-	NOTYPE = 256, EQ
+	TK_END = 256, TK_NUM, TK_REG, TK_SYMBOL,
+	TK_EQ, TK_NEQ, TK_LE, TK_GE, TK_SHL, TK_SHR, TK_AND, TK_OR
+};
+
+/* the lexer state */
+static char *input;
+static char *cur;		/* the next character to be scanned */
+static char *tk_start;	/* the current token */
+static int tk_type;
+static uint32_t tk_val;
+static int tk_len;		/* the length of the name of a register or symbol */
+
+static void error_at(char *p, const char *msg) {
+	int pos = p - input;
+	printf("%s at position %d\n%s\n%*.s^\n", msg, pos, input, pos, "");
+}
+
+static bool next_token() {
+	while(isspace((unsigned char)*cur)) { cur ++; }
+	tk_start = cur;
+
+	if(*cur == '\0') {
+		tk_type = TK_END;
+		return true;
+	}
+
+	if(isdigit((unsigned char)*cur)) {
+		tk_type = TK_NUM;
+		tk_val = strtoul(cur, &cur, 0);
+		if(isalnum((unsigned char)*cur) || *cur == '_') {
+			error_at(cur, "invalid number");
+			return false;
+		}
+		return true;
+	}
 
-	/* TODO: Add more token types */
+	if(*cur == '$' || isalpha((unsigned char)*cur) || *cur == '_') {
+		tk_type = (*cur == '$' ? TK_REG : TK_SYMBOL);
+		if(*cur == '$') { cur ++; }
+		char *name = cur;
+		while(isalnum((unsigned char)*cur) || *cur == '_') { cur ++; }
+		tk_len = cur - name;
+		if(tk_len == 0) {
+			error_at(cur, "missing register name");
+			return false;
+		}
+		return true;
+	}
+
+	static const struct {
+		char str[3];
+		int type;
+	} ops[] = {
+		{"==", TK_EQ}, {"!=", TK_NEQ}, {"<=", TK_LE}, {">=", TK_GE},
+		{"<<", TK_SHL}, {">>", TK_SHR}, {"&&", TK_AND}, {"||", TK_OR}
+	};
+	int i;
+	for(i = 0; i < sizeof(ops) / sizeof(ops[0]); i ++) {
+		if(cur[0] == ops[i].str[0] && cur[1] == ops[i].str[1]) {
+			tk_type = ops[i].type;
+			cur += 2;
+			return true;
+		}
+	}
+
+	if(strchr("+-*/%<>&|^!~?:()", *cur) != NULL) {
+		tk_type = *cur ++;
+		return true;
+	}
 
+	error_at(cur, "unexpected character");
+	return false;
+}
+
+/* the instructions of the stack machine */
+enum {
+	I_IMM, I_REG_L, I_REG_W, I_REG_B, I_EIP, I_DEREF,
+	I_NEG, I_NOT, I_LNOT,
+	I_MUL, I_DIV, I_MOD, I_ADD, I_SUB, I_SHL, I_SHR,
+	I_LT, I_LE, I_GT, I_GE, I_EQ, I_NEQ,
+	I_AND, I_XOR, I_OR,
+	I_AND_JMP,		/* jump with 0 on the stack if the top is 0, else pop it */
+	I_OR_JMP,		/* jump with 1 on the stack if the top is not 0, else pop it */
+	I_BOOL,			/* convert the top to 0 or 1 */
+	I_JZ,			/* pop the top and jump if it is 0 */
+	I_JMP
 };
 
-static struct rule {
-	char *regex;
-	int token_type;
-} rules[] = {
+typedef struct {
+	uint32_t type;
+	uint32_t val;
+} Instr;
 
-	/* TODO: Add more rules.
-	 * Pay attention to the precedence level of different rules.
-	 */
+#define MAX_CODE_LEN 256
+#define MAX_NESTING 64
 
-	{" +",	NOTYPE},				// spaces
-	{"\\+", '+'},					// plus
-	{"==", EQ}						// equal
+struct Expr {
+	int ref;
+	bool uses_reg;
+	int nr_code;
+	Instr code[];
 };
 
-#define NR_REGEX (sizeof(rules) / sizeof(rules[0]) )
+/* the parser state */
+static Instr code[MAX_CODE_LEN];
+static int nr_code;
+static bool uses_reg;
+static int nesting;
 
-static regex_t re[NR_REGEX];
+static bool emit(uint32_t type, uint32_t val) {
+	if(nr_code == MAX_CODE_LEN) {
+		printf("expression too complex\n");
+		return false;
+	}
+	code[nr_code].type = type;
+	code[nr_code].val = val;
+	nr_code ++;
+	return true;
+}
 
-/* Rules are used for many times.
- * Therefore we compile them only once before any usage.
- */
-void init_regex() {
+static bool parse_expr(int);
+
+static bool parse_reg() {
+	char *name = tk_start + 1;
 	int i;
-	char error_msg[128];
-	int ret;
-
-	for(i = 0; i < NR_REGEX; i ++) {
-		ret = regcomp(&re[i], rules[i].regex, REG_EXTENDED);
-		if(ret != 0) {
-			regerror(ret, &re[i], error_msg, 128);
-			Assert(ret == 0, "regex compilation failed: %s\n%s", error_msg, rules[i].regex);
-		}
+	uses_reg = true;
+	if(tk_len == 3 && strncmp(name, "eip", 3) == 0) { return emit(I_EIP, 0); }
+	for(i = R_EAX; i <= R_EDI; i ++) {
+		if(tk_len == 3 && strncmp(name, regsl[i], 3) == 0) { return emit(I_REG_L, i); }
+		if(tk_len == 2 && strncmp(name, regsw[i], 2) == 0) { return emit(I_REG_W, i); }
+		if(tk_len == 2 && strncmp(name, regsb[i], 2) == 0) { return emit(I_REG_B, i); }
 	}
+	printf("unknown register '%.*s'\n", tk_len + 1, tk_start);
+	return false;
 }
 
-typedef struct token {
-	int type;
-	char str[32];
-} Token;
+static bool parse_symbol() {
+	char name[tk_len + 1];
+	bool success;
+	memcpy(name, tk_start, tk_len);
+	name[tk_len] = '\0';
+
+	uint32_t val = look_up_symtab(name, &success);
+	if(!success) {
+		printf("no symbol '%s'\n", name);
+		return false;
+	}
+	return emit(I_IMM, val);
+}
 
-Token tokens[32];
-int nr_token;
+/* Parse a unary expression beginning with the current token. */
+static bool parse_unary() {
+	int op = tk_type;
+	bool ok;
 
-static bool make_token(char *e) {
-	int position = 0;
-	int i;
-	regmatch_t pmatch;
-	
-	nr_token = 0;
-
-	while(e[position] != '\0') {
-		/* Try all rules one by one. */
-		for(i = 0; i < NR_REGEX; i ++) {
-			if(regexec(&re[i], e + position, 1, &pmatch, 0) == 0 && pmatch.rm_so == 0) {
-				char *substr_start = e + position;
-				int substr_len = pmatch.rm_eo;
-
-				Log("match rules[%d] = \"%s\" at position %d with len %d: %.*s", i, rules[i].regex, position, substr_len, substr_len, substr_start);
-				position += substr_len;
-
-				/* TODO: Now a new token is recognized with rules[i]. Add codes
-				 * to record the token in the array `tokens'. For certain types
-				 * of tokens, some extra actions should be performed.
-				 */
-
-				switch(rules[i].token_type) {
-					default: panic("please implement me");
-				}
+	if(nesting == MAX_NESTING) {
+		printf("expression nested too deeply\n");
+		return false;
+	}
 
-				break;
+	switch(op) {
+		case '-': case '+': case '!': case '~': case '*':
+			nesting ++;
+			ok = next_token() && parse_unary();
+			nesting --;
+			if(!ok) { return false; }
+			switch(op) {
+				case '-': return emit(I_NEG, 0);
+				case '!': return emit(I_LNOT, 0);
+				case '~': return emit(I_NOT, 0);
+				case '*': return emit(I_DEREF, 0);
+				default: return true;
 			}
-		}
 
-		if(i == NR_REGEX) {
-			printf("no match at position %d\n%s\n%*.s^\n", position, e, position, "");
+		case '(':
+			nesting ++;
+			ok = next_token() && parse_expr(0);
+			nesting --;
+			if(!ok) { return false; }
+			if(tk_type != ')') {
+				error_at(tk_start, "missing ')'");
+				return false;
+			}
+			return next_token();
+
+		case TK_NUM: return emit(I_IMM, tk_val) && next_token();
+		case TK_REG: return parse_reg() && next_token();
+		case TK_SYMBOL: return parse_symbol() && next_token();
+
+		default:
+			error_at(tk_start, (op == TK_END ? "unexpected end of expression" : "unexpected token"));
 			return false;
+	}
+}
+
+/* Return the precedence level of a binary operator, or 0 if the token
+ * is not a binary operator. The conditional operator has level 1.
+ */
+#define PREC_COND 1
+
+static int binary_prec(int type, int *instr) {
+	switch(type) {
+		case TK_OR:  *instr = I_OR_JMP; return 2;
+		case TK_AND: *instr = I_AND_JMP; return 3;
+		case '|':    *instr = I_OR; return 4;
+		case '^':    *instr = I_XOR; return 5;
+		case '&':    *instr = I_AND; return 6;
+		case TK_EQ:  *instr = I_EQ; return 7;
+		case TK_NEQ: *instr = I_NEQ; return 7;
+		case '<':    *instr = I_LT; return 8;
+		case TK_LE:  *instr = I_LE; return 8;
+		case '>':    *instr = I_GT; return 8;
+		case TK_GE:  *instr = I_GE; return 8;
+		case TK_SHL: *instr = I_SHL; return 9;
+		case TK_SHR: *instr = I_SHR; return 9;
+		case '+':    *instr = I_ADD; return 10;
+		case '-':    *instr = I_SUB; return 10;
+		case '*':    *instr = I_MUL; return 11;
+		case '/':    *instr = I_DIV; return 11;
+		case '%':    *instr = I_MOD; return 11;
+		default: return 0;
+	}
+}
+
+/* Parse an expression whose operators have precedence levels not lower
+ * than `min_prec'. Binary operators are left associative, and the
+ * conditional operator is right associative.
+ */
+static bool parse_expr(int min_prec) {
+	int prec, instr;
+
+	if(!parse_unary()) { return false; }
+
+	while(1) {
+		if(tk_type == '?' && min_prec <= PREC_COND) {
+			int jz = nr_code, jmp;
+			if(!emit(I_JZ, 0) || !next_token() || !parse_expr(0)) { return false; }
+			if(tk_type != ':') {
+				error_at(tk_start, "missing ':'");
+				return false;
+			}
+			jmp = nr_code;
+			if(!emit(I_JMP, 0) || !next_token()) { return false; }
+			code[jz].val = nr_code;
+			if(!parse_expr(PREC_COND)) { return false; }
+			code[jmp].val = nr_code;
+			continue;
+		}
+
+		prec = binary_prec(tk_type, &instr);
+		if(prec == 0 || prec < min_prec) { break; }
+		if(!next_token()) { return false; }
+
+		if(instr == I_AND_JMP || instr == I_OR_JMP) {
+			/* `&&' and `||' short-circuit, so that `p && *p' is safe */
+			int j = nr_code;
+			if(!emit(instr, 0) || !parse_expr(prec + 1) || !emit(I_BOOL, 0)) { return false; }
+			code[j].val = nr_code;
+		}
+		else {
+			if(!parse_expr(prec + 1) || !emit(instr, 0)) { return false; }
 		}
 	}
 
-	return true; 
+	return true;
 }
 
-uint32_t expr(char *e, bool *success) {
-	if(!make_token(e)) {
-		*success = false;
-		return 0;
+static Expr* compile(char *e) {
+	input = cur = e;
+	nr_code = 0;
+	uses_reg = false;
+	nesting = 0;
+
+	if(!next_token() || !parse_expr(0)) { return NULL; }
+	if(tk_type != TK_END) {
+		error_at(tk_start, "unexpected token");
+		return NULL;
+	}
+
+	Expr *ex = malloc(sizeof(Expr) + sizeof(Instr) * nr_code);
+	assert(ex);
+	ex->ref = 1;
+	ex->uses_reg = uses_reg;
+	ex->nr_code = nr_code;
+	memcpy(ex->code, code, sizeof(Instr) * nr_code);
+	return ex;
+}
+
+/* Compiled expressions are cached by their strings, since the same
+ * expressions are evaluated again and again in scripted sessions.
+ * Symbols are compiled into constants, so an expression is only reused
+ * with the symbol table it was compiled with. The cache holds a reference
+ * to each expression in it.
+ */
+#define NR_CACHE 64
+
+static struct {
+	char *str;
+	uint32_t symtab_ver;
+	Expr *ex;
+} cache[NR_CACHE];
+
+Expr* expr_compile(char *e, bool *success) {
+	int idx = hash_str(e) % NR_CACHE;
+	Expr *ex;
+
+	if(cache[idx].str != NULL && cache[idx].symtab_ver == symtab_version() && strcmp(cache[idx].str, e) == 0) {
+		ex = cache[idx].ex;
 	}
+	else {
+		ex = compile(e);
+		if(ex == NULL) {
+			*success = false;
+			return NULL;
+		}
+
+		if(cache[idx].str != NULL) {
+			free(cache[idx].str);
+			expr_free(cache[idx].ex);
+		}
+		cache[idx].str = strdup(e);
+		cache[idx].symtab_ver = symtab_version();
+		cache[idx].ex = ex;
+	}
+
+	ex->ref ++;
+	*success = true;
+	return ex;
+}
 
-	/* TODO: Insert codes to evaluate the expression. */
-	panic("please implement me");
-	return 0;
+void expr_free(Expr *ex) {
+	assert(ex->ref > 0);
+	if(-- ex->ref == 0) { free(ex); }
 }
 
+bool expr_uses_reg(Expr *ex) {
+	return ex->uses_reg;
+}
+
+uint32_t expr_eval(Expr *ex, swaddr_t *deps, int *nr_dep, bool *success) {
+	uint32_t stack[MAX_CODE_LEN];
+	int top = -1, pc;
+
+	*success = false;
+	if(deps != NULL) { *nr_dep = 0; }
+
+	for(pc = 0; pc < ex->nr_code; pc ++) {
+		Instr *in = &ex->code[pc];
+		uint32_t src;
+		switch(in->type) {
+			case I_IMM: stack[++ top] = in->val; break;
+			case I_REG_L: stack[++ top] = reg_l(in->val); break;
+			case I_REG_W: stack[++ top] = reg_w(in->val); break;
+			case I_REG_B: stack[++ top] = reg_b(in->val); break;
+			case I_EIP: stack[++ top] = cpu.eip; break;
+
+			case I_DEREF:
+				if(!swaddr_valid(stack[top], 4, R_DS)) {
+					printf("cannot access memory at address 0x%x\n", stack[top]);
+					return 0;
+				}
+				if(deps != NULL && *nr_dep != -1) {
+					if(*nr_dep == EXPR_MAX_DEP) { *nr_dep = -1; }
+					else { deps[(*nr_dep) ++] = stack[top]; }
+				}
+				stack[top] = swaddr_read(stack[top], 4);
+				break;
+
+			case I_NEG: stack[top] = -stack[top]; break;
+			case I_NOT: stack[top] = ~stack[top]; break;
+			case I_LNOT: stack[top] = !stack[top]; break;
+			case I_BOOL: stack[top] = (stack[top] != 0); break;
+
+			case I_AND_JMP:
+				if(stack[top] == 0) { pc = in->val - 1; }
+				else { top --; }
+				break;
+			case I_OR_JMP:
+				if(stack[top] != 0) { stack[top] = 1; pc = in->val - 1; }
+				else { top --; }
+				break;
+			case I_JZ:
+				if(stack[top --] == 0) { pc = in->val - 1; }
+				break;
+			case I_JMP: pc = in->val - 1; break;
+
+			default:
+				/* binary operators */
+				src = stack[top --];
+				switch(in->type) {
+					case I_ADD: stack[top] += src; break;
+					case I_SUB: stack[top] -= src; break;
+					case I_MUL: stack[top] *= src; break;
+					case I_DIV:
+					case I_MOD:
+						if(src == 0) {
+							printf("division by zero\n");
+							return 0;
+						}
+						stack[top] = (in->type == I_DIV ? stack[top] / src : stack[top] % src);
+						break;
+					case I_SHL: stack[top] = (src < 32 ? stack[top] << src : 0); break;
+					case I_SHR: stack[top] = (src < 32 ? stack[top] >> src : 0); break;
+					case I_LT: stack[top] = (stack[top] < src); break;
+					case I_LE: stack[top] = (stack[top] <= src); break;
+					case I_GT: stack[top] = (stack[top] > src); break;
+					case I_GE: stack[top] = (stack[top] >= src); break;
+					case I_EQ: stack[top] = (stack[top] == src); break;
+					case I_NEQ: stack[top] = (stack[top] != src); break;
+					case I_AND: stack[top] &= src; break;
+					case I_XOR: stack[top] ^= src; break;
+					case I_OR: stack[top] |= src; break;
+					default: assert(0);
+				}
+		}
+	}
+
+	assert(top == 0);
+	*success = true;
+	return stack[0];
+}
+
+uint32_t expr(char *e, bool *success) {
+	Expr *ex = expr_compile(e, success);
+	if(!*success) { return 0; }
+
+	uint32_t val = expr_eval(ex, NULL, NULL, success);
+	expr_free(ex);
+	return val;
+}
@@ -0,0 +1,254 @@
+#include "nemu.h"
+#include "monitor/monitor.h"
+#include "monitor/symbol.h"
+
+#include <stdlib.h>
+
+/* A sampling profiler for the guest. Every `sample_interval' instructions
+ * the current eip is recorded into a histogram, and the call stack is
+ * recorded by walking the chain of %ebp. At exit, a flat profile of the
+ * functions and the folded stacks (the input format of flamegraph.pl)
+ * are written to files.
+ */
+
+#define PROFILE_FLAT_FILE "profile-flat.txt"
+#define PROFILE_FOLDED_FILE "profile-folded.txt"
+
+#define MAX_STACK_DEPTH 64
+#define INIT_HASH_SIZE 1024
+
+/* Checked by cpu_exec() after each instruction. */
+uint64_t next_sample = -1;
+static uint32_t sample_interval = 0;
+static uint64_t nr_sample = 0;
+
+static inline uint32_t hash32(uint32_t x) {
+	return x * 2654435761u;
+}
+
+/* histogram of eip, indexed by an open addressing hash table */
+typedef struct {
+	swaddr_t eip;
+	uint32_t cnt;
+} EIPBucket;
+
+static EIPBucket *eip_hist = NULL;
+static uint32_t eip_hist_size, nr_eip;
+
+/* histogram of call stacks */
+typedef struct {
+	uint32_t hash;
+	int depth;
+	int *frames;	/* symbol indices, the innermost one first */
+	uint32_t cnt;
+} StackBucket;
+
+static StackBucket *stack_hist = NULL;
+static uint32_t stack_hist_size, nr_stack;
+
+static void eip_hist_insert(swaddr_t eip, uint32_t cnt) {
+	uint32_t mask = eip_hist_size - 1;
+	uint32_t i = hash32(eip) & mask;
+	while(eip_hist[i].cnt != 0 && eip_hist[i].eip != eip) { i = (i + 1) & mask; }
+
+	if(eip_hist[i].cnt == 0) {
+		eip_hist[i].eip = eip;
+		nr_eip ++;
+	}
+	eip_hist[i].cnt += cnt;
+}
+
+static void eip_hist_grow() {
+	EIPBucket *old = eip_hist;
+	uint32_t old_size = eip_hist_size, i;
+
+	eip_hist_size = (old == NULL ? INIT_HASH_SIZE : old_size * 2);
+	eip_hist = calloc(eip_hist_size, sizeof(EIPBucket));
+	assert(eip_hist);
+	nr_eip = 0;
+
+	for(i = 0; i < old_size; i ++) {
+		if(old[i].cnt != 0) { eip_hist_insert(old[i].eip, old[i].cnt); }
+	}
+	free(old);
+}
+
+static uint32_t hash_frames(int *frames, int depth) {
+	uint32_t h = depth;
+	int i;
+	for(i = 0; i < depth; i ++) { h = hash32(h ^ frames[i]); }
+	return h;
+}
+
+static StackBucket* stack_hist_lookup(uint32_t hash, int *frames, int depth) {
+	uint32_t mask = stack_hist_size - 1;
+	uint32_t i = hash & mask;
+	while(stack_hist[i].cnt != 0) {
+		StackBucket *b = &stack_hist[i];
+		if(b->hash == hash && b->depth == depth &&
+				memcmp(b->frames, frames, sizeof(int) * depth) == 0) {
+			break;
+		}
+		i = (i + 1) & mask;
+	}
+	return &stack_hist[i];
+}
+
+static void stack_hist_grow() {
+	StackBucket *old = stack_hist;
+	uint32_t old_size = stack_hist_size, i;
+
+	stack_hist_size = (old == NULL ? INIT_HASH_SIZE : old_size * 2);
+	stack_hist = calloc(stack_hist_size, sizeof(StackBucket));
+	assert(stack_hist);
+
+	for(i = 0; i < old_size; i ++) {
+		if(old[i].cnt != 0) {
+			*stack_hist_lookup(old[i].hash, old[i].frames, old[i].depth) = old[i];
+		}
+	}
+	free(old);
+}
+
+static void record_stack(int *frames, int depth) {
+	if((nr_stack + 1) * 4 > stack_hist_size * 3) { stack_hist_grow(); }
+
+	uint32_t hash = hash_frames(frames, depth);
+	StackBucket *b = stack_hist_lookup(hash, frames, depth);
+	if(b->cnt == 0) {
+		b->hash = hash;
+		b->depth = depth;
+		b->frames = malloc(sizeof(int) * depth);
+		memcpy(b->frames, frames, sizeof(int) * depth);
+		nr_stack ++;
+	}
+	b->cnt ++;
+}
+
+/* Read a stack frame in the stack segment without triggering an error in
+ * the memory system.
+ */
+static bool read_frame(swaddr_t ebp, swaddr_t *next_ebp, swaddr_t *ret_addr) {
+	if(ebp == 0 || !swaddr_valid(ebp, 8, R_SS)) { return false; }
+	uint8_t sreg = current_sreg;
+	current_sreg = R_SS;
+	*next_ebp = swaddr_read(ebp, 4);
+	*ret_addr = swaddr_read(ebp + 4, 4);
+	current_sreg = sreg;
+	return true;
+}
+
+void profile_sample() {
+	int frames[MAX_STACK_DEPTH];
+	int depth = 0;
+	swaddr_t ebp = cpu.ebp, ret_addr;
+
+	if((nr_eip + 1) * 4 > eip_hist_size * 3) { eip_hist_grow(); }
+	eip_hist_insert(cpu.eip, 1);
+
+	frames[depth ++] = find_symbol(cpu.eip);
+	while(depth < MAX_STACK_DEPTH && read_frame(ebp, &ebp, &ret_addr)) {
+		frames[depth ++] = find_symbol(ret_addr);
+	}
+	record_stack(frames, depth);
+
+	nr_sample ++;
+	next_sample = nr_instr + sample_interval;
+}
+
+void profile_start(uint32_t interval) {
+	assert(interval > 0);
+	sample_interval = interval;
+	next_sample = nr_instr + interval;
+}
+
+static const char* func_name(int idx) {
+	return (idx == -1 ? "[unknown]" : get_symbol(idx)->name);
+}
+
+typedef struct {
+	int func;
+	uint32_t self, total;
+	uint64_t last_stack;
+} FuncProfile;
+
+static int func_profile_cmp(const void *a, const void *b) {
+	const FuncProfile *x = a, *y = b;
+	if(x->self != y->self) { return (x->self < y->self) - (x->self > y->self); }
+	return (x->total < y->total) - (x->total > y->total);
+}
+
+static void write_flat_profile() {
+	FILE *fp = fopen(PROFILE_FLAT_FILE, "w");
+	Assert(fp, "Can not open '%s'", PROFILE_FLAT_FILE);
+
+	/* prof[0] is for the unknown function, prof[i + 1] is for symbol i */
+	int nr_prof = get_nr_symbol() + 1;
+	FuncProfile *prof = calloc(nr_prof, sizeof(FuncProfile));
+	uint32_t i;
+	int j;
+
+	for(j = 0; j < nr_prof; j ++) { prof[j].func = j - 1; }
+
+	for(i = 0; i < eip_hist_size; i ++) {
+		if(eip_hist[i].cnt != 0) {
+			prof[find_symbol(eip_hist[i].eip) + 1].self += eip_hist[i].cnt;
+		}
+	}
+
+	for(i = 0; i < stack_hist_size; i ++) {
+		StackBucket *b = &stack_hist[i];
+		if(b->cnt == 0) { continue; }
+		for(j = 0; j < b->depth; j ++) {
+			FuncProfile *p = &prof[b->frames[j] + 1];
+			/* A recursive function is counted only once in a stack. */
+			if(p->last_stack != i + 1) {
+				p->last_stack = i + 1;
+				p->total += b->cnt;
+			}
+		}
+	}
+
+	qsort(prof, nr_prof, sizeof(FuncProfile), func_profile_cmp);
+
+	fprintf(fp, "%llu samples, one sample every %u instructions\n\n",
+			(unsigned long long)nr_sample, sample_interval);
+	fprintf(fp, "%7s %10s %7s %10s  %s\n", "self%", "self", "total%", "total", "function");
+	for(j = 0; j < nr_prof && prof[j].total != 0; j ++) {
+		fprintf(fp, "%6.2f%% %10u %6.2f%% %10u  %s\n",
+				prof[j].self * 100.0 / nr_sample, prof[j].self,
+				prof[j].total * 100.0 / nr_sample, prof[j].total, func_name(prof[j].func));
+	}
+
+	free(prof);
+	fclose(fp);
+}
+
+static void write_folded_stacks() {
+	FILE *fp = fopen(PROFILE_FOLDED_FILE, "w");
+	Assert(fp, "Can not open '%s'", PROFILE_FOLDED_FILE);
+
+	uint32_t i;
+	int j;
+	for(i = 0; i < stack_hist_size; i ++) {
+		StackBucket *b = &stack_hist[i];
+		if(b->cnt == 0) { continue; }
+
+		/* the outermost function first */
+		for(j = b->depth - 1; j >= 0; j --) {
+			fprintf(fp, "%s%c", func_name(b->frames[j]), (j == 0 ? ' ' : ';'));
+		}
+		fprintf(fp, "%u\n", b->cnt);
+	}
+
+	fclose(fp);
+}
+
+void profile_report() {
+	if(nr_sample == 0) { return; }
+
+	write_flat_profile();
+	write_folded_stacks();
+	printf("nemu: profile with %llu samples is written to '%s' and '%s'\n",
+			(unsigned long long)nr_sample, PROFILE_FLAT_FILE, PROFILE_FOLDED_FILE);
+}
@@ -1,6 +1,9 @@
 #include "monitor/monitor.h"
 #include "monitor/expr.h"
 #include "monitor/watchpoint.h"
+#include "monitor/breakpoint.h"
+#include "monitor/snapshot.h"
+#include "memory/mmu.h"
 #include "nemu.h"
 
 #include <stdlib.h>
@@ -8,6 +11,16 @@
 #include <readline/history.h>
 
 void cpu_exec(uint32_t);
+void profile_start(uint32_t);
+void opcode_stat_report();
+void trace_start(const char *, bool, bool);
+void trace_stop();
+void start_checkpoints(uint32_t);
+void stop_checkpoints();
+void print_checkpoints();
+void reverse_step(uint64_t);
+void reverse_continue();
+extern bool trace_enabled;
 
 /* We use the `readline' library to provide more flexibility to read from stdin. */
 char* rl_gets() {
@@ -36,6 +49,192 @@ static int cmd_q(char *args) {
 	return -1;
 }
 
+static int cmd_profile(char *args) {
+	uint32_t interval = 1000;
+	if(args != NULL && sscanf(args, "%u", &interval) != 1) {
+		printf("Usage: profile [N]\n");
+		return 0;
+	}
+	if(interval == 0) {
+		printf("The sampling interval should be positive\n");
+		return 0;
+	}
+
+	profile_start(interval);
+	printf("Sample the guest every %u instructions\n", interval);
+	return 0;
+}
+
+#ifdef DEBUG
+static int cmd_log(char *args) {
+	extern bool log_instr;
+	char *arg = strtok(NULL, " ");
+	if(arg != NULL && strcmp(arg, "on") == 0) { log_instr = true; }
+	else if(arg != NULL && strcmp(arg, "off") == 0) { log_instr = false; }
+	else { printf("Usage: log on|off\n"); }
+	return 0;
+}
+#endif
+
+static int cmd_trace(char *args) {
+	char *arg = strtok(NULL, " ");
+	if(arg == NULL) {
+		printf("Usage: trace FILE [reg] [mem] | trace off\n");
+		return 0;
+	}
+
+	if(strcmp(arg, "off") == 0) {
+		trace_stop();
+		return 0;
+	}
+
+	if(trace_enabled) {
+		printf("The instruction trace is being recorded, stop it with 'trace off' first\n");
+		return 0;
+	}
+
+	char *filename = arg;
+	bool reg = false, mem = false;
+	while((arg = strtok(NULL, " ")) != NULL) {
+		if(strcmp(arg, "reg") == 0) { reg = true; }
+		else if(strcmp(arg, "mem") == 0) { mem = true; }
+		else {
+			printf("Unknown option '%s'\n", arg);
+			return 0;
+		}
+	}
+
+	trace_start(filename, reg, mem);
+	return 0;
+}
+
+#ifdef OPCODE_STAT
+static int cmd_opstat(char *args) {
+	opcode_stat_report();
+	return 0;
+}
+#endif
+
+static int cmd_p(char *args) {
+	bool success;
+	if(args == NULL) {
+		printf("Usage: p EXPR\n");
+		return 0;
+	}
+
+	uint32_t val = expr(args, &success);
+	if(success) {
+		printf("%u (0x%x)\n", val, val);
+	}
+	return 0;
+}
+
+static int cmd_w(char *args) {
+	if(args == NULL) {
+		printf("Usage: w EXPR\n");
+		return 0;
+	}
+
+	WP *wp = new_wp(args);
+	if(wp != NULL) {
+		printf("Watchpoint %d: %s\n", wp->NO, args);
+	}
+	return 0;
+}
+
+static int cmd_d(char *args) {
+	int NO;
+	if(args == NULL || sscanf(args, "%d", &NO) != 1) {
+		printf("Usage: d N\n");
+		return 0;
+	}
+
+	if(!delete_wp(NO)) {
+		printf("No watchpoint number %d\n", NO);
+	}
+	return 0;
+}
+
+static int cmd_b(char *args) {
+	bool success;
+	if(args == NULL) {
+		printf("Usage: b EXPR\n");
+		return 0;
+	}
+
+	swaddr_t addr = expr(args, &success);
+	if(success) {
+		int NO = set_bp(addr);
+		if(NO != -1) { printf("Breakpoint %d at 0x%08x\n", NO, addr); }
+	}
+	return 0;
+}
+
+static int cmd_clear(char *args) {
+	bool success;
+	if(args == NULL) {
+		printf("Usage: clear EXPR\n");
+		return 0;
+	}
+
+	swaddr_t addr = expr(args, &success);
+	if(success && !clear_bp(addr)) {
+		printf("No breakpoint at 0x%08x\n", addr);
+	}
+	return 0;
+}
+
+static int cmd_info(char *args) {
+	char *arg = strtok(NULL, " ");
+	if(arg != NULL && strcmp(arg, "w") == 0) { print_wps(); }
+	else if(arg != NULL && strcmp(arg, "b") == 0) { print_bps(); }
+	else if(arg != NULL && strcmp(arg, "m") == 0) {
+		printf("%zu KB of %d MB memory written by the machine in the host\n", dram_resident() / 1024, HW_MEM_SIZE >> 20);
+	}
+	else if(arg != NULL && strcmp(arg, "tlb") == 0) { mmu_report(); }
+	else { printf("Usage: info w|b|m|tlb\n"); }
+	return 0;
+}
+
+static int cmd_savevm(char *args) {
+	char *arg = strtok(NULL, " ");
+	if(arg == NULL) { printf("Usage: savevm FILE\n"); }
+	else { savevm(arg); }
+	return 0;
+}
+
+static int cmd_loadvm(char *args) {
+	char *arg = strtok(NULL, " ");
+	if(arg == NULL) { printf("Usage: loadvm FILE\n"); }
+	else { loadvm(arg); }
+	return 0;
+}
+
+static int cmd_checkpoint(char *args) {
+	uint32_t interval;
+	char *arg = strtok(NULL, " ");
+	if(arg == NULL) { print_checkpoints(); }
+	else if(strcmp(arg, "off") == 0) { stop_checkpoints(); }
+	else if(sscanf(arg, "%u", &interval) == 1 && interval > 0) { start_checkpoints(interval); }
+	else { printf("Usage: checkpoint [N | off]\n"); }
+	return 0;
+}
+
+static int cmd_rs(char *args) {
+	unsigned long long n = 1;
+	if(args != NULL && (sscanf(args, "%llu", &n) != 1 || n == 0)) {
+		printf("Usage: rs [N]\n");
+		return 0;
+	}
+	reverse_step(n);
+	return 0;
+}
+
+static int cmd_rc(char *args) {
+	reverse_continue();
+	return 0;
+}
+
 static int cmd_help(char *args);
 
 static struct {
@@ -46,6 +245,25 @@ static struct {
 	{ "help", "Display informations about all supported commands", cmd_help },
 	{ "c", "Continue the execution of the program", cmd_c },
 	{ "q", "Exit NEMU", cmd_q },
+	{ "p", "Evaluate the expression EXPR", cmd_p },
+	{ "w", "Stop the execution when the value of EXPR changes", cmd_w },
+	{ "d", "Delete watchpoint N", cmd_d },
+	{ "b", "Stop the execution before the instruction at address EXPR", cmd_b },
+	{ "clear", "Delete the breakpoint at address EXPR", cmd_clear },
+	{ "info", "'info w' displays all watchpoints, 'info b' displays all breakpoints, 'info m' displays the memory usage, 'info tlb' displays the page walks", cmd_info },
+	{ "profile", "Profile the guest by sampling every N (default 1000) instructions", cmd_profile },
+#ifdef DEBUG
+	{ "log", "'log on' writes the assembly code of every instruction executed into log.txt, 'log off' (the default) stops it", cmd_log },
+#endif
+	{ "savevm", "Save the state of the whole machine into FILE", cmd_savevm },
+	{ "loadvm", "Restore the state of the whole machine from FILE", cmd_loadvm },
+	{ "checkpoint", "Take a checkpoint every N instructions for reverse execution, or turn it off", cmd_checkpoint },
+	{ "rs", "Step back N (default 1) instructions", cmd_rs },
+	{ "rc", "Run backwards until the last place where a breakpoint or a watchpoint stopped", cmd_rc },
+	{ "trace", "Record a binary instruction trace into FILE, optionally with register and memory changes", cmd_trace },
+#ifdef OPCODE_STAT
+	{ "opstat", "Display the instructions retired and host cycles spent for each opcode", cmd_opstat },
+#endif
 
 	/* TODO: Add more commands */
 
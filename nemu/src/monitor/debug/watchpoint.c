@@ -1,11 +1,19 @@
 #include "monitor/watchpoint.h"
 #include "monitor/expr.h"
+#include "nemu.h"
+#include "monitor/checkpoint.h"
+
+#include <stdlib.h>
 
 #define NR_WP 32
 
 static WP wp_pool[NR_WP];
 static WP *head, *free_;
 
+uint8_t wp_page_map[1 << (32 - WP_PAGE_SHIFT - 3)];
+bool wp_mem_hit = false;
+int nr_eager_wp = 0;
+
 void init_wp_pool() {
 	int i;
 	for(i = 0; i < NR_WP; i ++) {
@@ -18,6 +26,181 @@ void init_wp_pool() {
 	free_ = wp_pool;
 }
 
-/* TODO: Implement the functionality of watchpoint */
+static void set_page(swaddr_t addr) {
+	wp_page_map[addr >> (WP_PAGE_SHIFT + 3)] |= 1 << ((addr >> WP_PAGE_SHIFT) & 0x7);
+}
+
+static void clear_page(swaddr_t addr) {
+	wp_page_map[addr >> (WP_PAGE_SHIFT + 3)] &= ~(1 << ((addr >> WP_PAGE_SHIFT) & 0x7));
+}
+
+/* Clear the pages of the memory words of `wp', and set again the pages
+ * of all watchpoints, since a page may be shared by several of them.
+ */
+static void update_page_map(WP *wp, swaddr_t *old_deps, int old_nr_dep) {
+	int i;
+	for(i = 0; i < old_nr_dep; i ++) {
+		clear_page(old_deps[i]);
+		clear_page(old_deps[i] + 3);
+	}
+
+	for(wp = head; wp != NULL; wp = wp->next) {
+		for(i = 0; i < wp->nr_dep; i ++) {
+			set_page(wp->deps[i]);
+			set_page(wp->deps[i] + 3);
+		}
+	}
+}
+
+static void set_eager(WP *wp, bool eager) {
+	if(wp->eager != eager) {
+		nr_eager_wp += (eager ? 1 : -1);
+		wp->eager = eager;
+	}
+}
+
+/* Evaluate `wp' and update the memory words it depends on. */
+static bool eval_wp(WP *wp, uint32_t *val) {
+	swaddr_t old_deps[EXPR_MAX_DEP];
+	int old_nr_dep = wp->nr_dep;
+	bool success;
+
+	if(old_nr_dep > 0) { memcpy(old_deps, wp->deps, sizeof(old_deps[0]) * old_nr_dep); }
+	*val = expr_eval(wp->expr, wp->deps, &wp->nr_dep, &success);
+	if(!success) { wp->nr_dep = 0; }
+
+	if(wp->nr_dep != old_nr_dep ||
+			(wp->nr_dep > 0 && memcmp(old_deps, wp->deps, sizeof(old_deps[0]) * wp->nr_dep) != 0)) {
+		update_page_map(wp, old_deps, old_nr_dep);
+	}
+
+	set_eager(wp, expr_uses_reg(wp->expr) || wp->nr_dep == -1);
+	wp->dirty = false;
+	return success;
+}
+
+WP* new_wp(char *e) {
+	if(free_ == NULL) {
+		printf("Too many watchpoints\n");
+		return NULL;
+	}
+
+	bool success;
+	Expr *ex = expr_compile(e, &success);
+	if(!success) { return NULL; }
+
+	WP *wp = free_;
+	wp->str = strdup(e);
+	wp->expr = ex;
+	wp->nr_dep = 0;
+	wp->eager = false;
+
+	if(!eval_wp(wp, &wp->val)) {
+		free(wp->str);
+		expr_free(ex);
+		set_eager(wp, false);
+		return NULL;
+	}
+
+	free_ = free_->next;
+	wp->next = head;
+	head = wp;
+	update_page_map(wp, NULL, 0);
+	return wp;
+}
+
+static void free_wp(WP *wp) {
+	WP **p;
+	for(p = &head; *p != wp; p = &(*p)->next) {
+		assert(*p != NULL);
+	}
+	*p = wp->next;
+
+	wp->next = free_;
+	free_ = wp;
+
+	update_page_map(wp, wp->deps, wp->nr_dep);
+	set_eager(wp, false);
+	free(wp->str);
+	expr_free(wp->expr);
+}
+
+bool delete_wp(int NO) {
+	WP *wp;
+	for(wp = head; wp != NULL; wp = wp->next) {
+		if(wp->NO == NO) {
+			free_wp(wp);
+			return true;
+		}
+	}
+	return false;
+}
+
+void print_wps() {
+	WP *wp;
+	if(head == NULL) {
+		printf("No watchpoints.\n");
+		return;
+	}
+
+	printf("Num  Value       What\n");
+	for(wp = head; wp != NULL; wp = wp->next) {
+		printf("%-4d 0x%08x  %s\n", wp->NO, wp->val, wp->str);
+	}
+}
+
+/* Called by swaddr_write() when it writes a watched page. Mark the
+ * watchpoints depending on the memory words written.
+ */
+void wp_mem_write(swaddr_t addr, size_t len) {
+	WP *wp;
+	int i;
+	for(wp = head; wp != NULL; wp = wp->next) {
+		for(i = 0; i < wp->nr_dep; i ++) {
+			if(addr < wp->deps[i] + 4 && wp->deps[i] < addr + len) {
+				wp->dirty = true;
+				wp_mem_hit = true;
+				break;
+			}
+		}
+	}
+}
 
+/* Evaluate all watchpoints again without reporting, called when the
+ * machine state is restored.
+ */
+void reset_watchpoints() {
+	WP *wp;
+	for(wp = head; wp != NULL; wp = wp->next) {
+		eval_wp(wp, &wp->val);
+	}
+	wp_mem_hit = false;
+}
+
+/* Called by cpu_exec() if `wp_mem_hit' is set or there are eager
+ * watchpoints. Return whether the value of some watchpoint is changed.
+ */
+bool check_watchpoints() {
+	WP *wp;
+	bool changed = false;
+	uint32_t val;
+
+	for(wp = head; wp != NULL; wp = wp->next) {
+		if(!wp->eager && !wp->dirty) { continue; }
 
+		if(eval_wp(wp, &val) && val != wp->val) {
+			if(replaying) {
+				wp->val = val;
+				changed = true;
+				continue;
+			}
+			if(!changed) { printf("\n"); }
+			printf("Watchpoint %d: %s\n\nOld value = 0x%08x\nNew value = 0x%08x\n", wp->NO, wp->str, wp->val, val);
+			wp->val = val;
+			changed = true;
+		}
+	}
+
+	wp_mem_hit = false;
+	return changed;
+}
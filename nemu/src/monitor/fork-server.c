@@ -0,0 +1,148 @@
+#include "nemu.h"
+#include "monitor/monitor.h"
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/stat.h>
+
+/* The fork server runs the program to the first NEMU_HC_GET_INPUT
+ * hypercall, e.g. after the guest kernel boots. Then for each input
+ * requested by the client, it forks a child which receives the input
+ * as the result of the hypercall and runs to the end. The children
+ * share the booted machine copy-on-write.
+ *
+ * The client talks to the server through two pipes:
+ *
+ *   FORKSRV_CTL_FD (client -> server):  uint32_t len; uint8_t input[len];
+ *   FORKSRV_ST_FD  (server -> client):  int32_t status;
+ *
+ * The server writes a status of 0 when it is ready. For each input, it
+ * writes the wait status of the child, whose exit status is 0 only if
+ * the program hits the good trap. An input longer than MAX_INPUT_LEN is
+ * dropped with a status of FORKSRV_ST_TOO_LONG. The server exits when the
+ * control pipe is closed.
+ */
+
+#define FORKSRV_CTL_FD 198
+#define FORKSRV_ST_FD 199
+
+#define FORKSRV_ST_TOO_LONG -1
+#define MAX_INPUT_LEN HW_MEM_SIZE
+
+bool fork_server_mode = false;
+
+/* the input for NEMU_HC_GET_INPUT when not in the fork server mode */
+char *input_file = NULL;
+
+static bool read_all(int fd, void *buf, size_t len) {
+	while(len > 0) {
+		ssize_t ret = read(fd, buf, len);
+		if(ret <= 0) { return false; }
+		buf = (uint8_t *)buf + ret;
+		len -= ret;
+	}
+	return true;
+}
+
+/* Read and drop `len' bytes. */
+static bool skip_all(int fd, size_t len) {
+	uint8_t buf[4096];
+	while(len > 0) {
+		size_t n = (len < sizeof(buf) ? len : sizeof(buf));
+		if(!read_all(fd, buf, n)) { return false; }
+		len -= n;
+	}
+	return true;
+}
+
+static void write_status(int32_t status) {
+	Assert(write(FORKSRV_ST_FD, &status, sizeof(status)) == sizeof(status),
+			"failed to write the status pipe of the fork server");
+}
+
+/* Copy the input into the guest buffer, and return its length. */
+static uint32_t copy_input(swaddr_t buf, uint32_t size, const uint8_t *input, uint32_t len) {
+	uint32_t i = 0, word;
+	if(len > size) { len = size; }
+	for(; i + 4 <= len; i += 4) {
+		memcpy(&word, input + i, 4);
+		swaddr_write(buf + i, 4, word);
+	}
+	for(; i < len; i ++) {
+		swaddr_write(buf + i, 1, input[i]);
+	}
+	return len;
+}
+
+static uint32_t read_input_file(swaddr_t buf, uint32_t size) {
+	FILE *fp = fopen(input_file, "rb");
+	Assert(fp, "Can not open '%s'", input_file);
+
+	/* The size of the buffer comes from the guest, only read what fits. */
+	struct stat st;
+	Assert(fstat(fileno(fp), &st) == 0, "Can not stat '%s'", input_file);
+	if(st.st_size < size) { size = st.st_size; }
+
+	uint8_t *input = malloc(size);
+	Assert(size == 0 || input, "Can not allocate %u bytes for the input", size);
+	uint32_t len = fread(input, 1, size, fp);
+	fclose(fp);
+
+	len = copy_input(buf, size, input, len);
+	free(input);
+	return len;
+}
+
+static void serve() {
+	uint32_t len;
+	uint8_t *input = NULL;
+
+	write_status(0);
+	while(read_all(FORKSRV_CTL_FD, &len, sizeof(len))) {
+		if(len > MAX_INPUT_LEN) {
+			/* Keep the pipe in step with the client for the next input. */
+			if(!skip_all(FORKSRV_CTL_FD, len)) { break; }
+			write_status(FORKSRV_ST_TOO_LONG);
+			continue;
+		}
+
+		input = realloc(input, len + 1);
+		assert(input);
+		if(!read_all(FORKSRV_CTL_FD, input, len)) { break; }
+
+		/* Do not let the children output what is still buffered. */
+		fflush(stdout);
+		fflush(log_fp);
+
+		pid_t pid = fork();
+		Assert(pid != -1, "fork() failed");
+		if(pid == 0) {
+			close(FORKSRV_CTL_FD);
+			close(FORKSRV_ST_FD);
+			fork_server_mode = false;
+			uint32_t ret = copy_input(cpu.ebx, cpu.ecx, input, len);
+			free(input);
+			cpu.eax = ret;
+			return;
+		}
+
+		int status;
+		Assert(waitpid(pid, &status, 0) == pid, "waitpid() failed");
+		write_status(status);
+	}
+
+	exit(0);
+}
+
+/* Handle the hypercall NEMU_HC_GET_INPUT. In the fork server mode,
+ * it only returns in the children.
+ */
+uint32_t get_input(swaddr_t buf, uint32_t size) {
+	if(fork_server_mode) {
+		serve();
+		return cpu.eax;
+	}
+
+	return (input_file != NULL ? read_input_file(buf, size) : 0);
+}
@@ -0,0 +1,141 @@
+#include "nemu.h"
+#include "monitor/monitor.h"
+#include "../../lib-common/trap.h"
+
+#include <time.h>
+
+uint32_t get_input(swaddr_t, uint32_t);
+
+/* Hypercalls let the guest talk to NEMU through the trap instruction.
+ * See lib-common/trap.h for the calling convention.
+ */
+
+#define NR_REGION 32
+#define REGION_NAME_LEN 32
+#define REGION_STACK_SIZE 16
+
+typedef struct {
+	char name[REGION_NAME_LEN];
+	uint32_t cnt;
+	uint64_t instr;
+	uint64_t ns;
+} Region;
+
+static __thread Region regions[NR_REGION];
+static __thread int nr_region = 0;
+
+/* regions which have begun but not ended yet */
+static __thread struct {
+	Region *r;
+	uint64_t instr;
+	uint64_t ns;
+} region_stack[REGION_STACK_SIZE];
+static __thread int region_depth = 0;
+
+uint64_t get_host_time() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void read_guest_str(swaddr_t addr, char *buf, int len) {
+	int i;
+	for(i = 0; i < len - 1; i ++) {
+		buf[i] = swaddr_read(addr + i, 1);
+		if(buf[i] == '\0') { return; }
+	}
+	buf[i] = '\0';
+}
+
+static Region* find_region(const char *name) {
+	int i;
+	for(i = 0; i < nr_region; i ++) {
+		if(strcmp(regions[i].name, name) == 0) { return &regions[i]; }
+	}
+
+	if(nr_region == NR_REGION) { return NULL; }
+
+	Region *r = &regions[nr_region ++];
+	strcpy(r->name, name);
+	r->cnt = 0;
+	r->instr = 0;
+	r->ns = 0;
+	return r;
+}
+
+static void region_begin(swaddr_t name_addr) {
+	char name[REGION_NAME_LEN];
+	read_guest_str(name_addr, name, REGION_NAME_LEN);
+
+	if(region_depth < REGION_STACK_SIZE) {
+		Region *r = find_region(name);
+		if(r == NULL) {
+			printf("nemu: too many profiling regions, '%s' is ignored\n", name);
+		}
+		region_stack[region_depth].r = r;
+		/* do not count the trap instruction itself */
+		region_stack[region_depth].instr = nr_instr + 1;
+		region_stack[region_depth].ns = get_host_time();
+	}
+	else {
+		printf("nemu: profiling regions nested too deep, '%s' is ignored\n", name);
+	}
+
+	/* Keep counting the depth even if the region is ignored,
+	 * so that the following ends still match their begins.
+	 */
+	region_depth ++;
+}
+
+static void region_end() {
+	if(region_depth == 0) {
+		printf("nemu: region end without begin at eip = 0x%08x\n", cpu.eip);
+		return;
+	}
+
+	region_depth --;
+	if(region_depth < REGION_STACK_SIZE && region_stack[region_depth].r != NULL) {
+		Region *r = region_stack[region_depth].r;
+		r->cnt ++;
+		r->instr += nr_instr - region_stack[region_depth].instr;
+		r->ns += get_host_time() - region_stack[region_depth].ns;
+	}
+}
+
+static void print_region_stats() {
+	int i;
+	printf("%-*s %10s %16s %14s %10s\n", REGION_NAME_LEN, "region",
+			"count", "instructions", "host time(ms)", "MIPS");
+	for(i = 0; i < nr_region; i ++) {
+		Region *r = &regions[i];
+		printf("%-*s %10u %16llu %14.3f %10.3f\n", REGION_NAME_LEN, r->name, r->cnt,
+				(unsigned long long)r->instr, r->ns / 1e6,
+				(r->ns == 0 ? 0.0 : r->instr * 1e3 / r->ns));
+	}
+}
+
+void do_hypercall() {
+	uint64_t ret = 0;
+
+	switch(cpu.eax) {
+		case NEMU_HC_INSTR_CNT: ret = nr_instr; break;
+		case NEMU_HC_HOST_TIME: ret = get_host_time(); break;
+		case NEMU_HC_REGION_BEGIN: region_begin(cpu.ebx); break;
+		case NEMU_HC_REGION_END: region_end(); break;
+		case NEMU_HC_DUMP_STATS: print_region_stats(); break;
+		case NEMU_HC_GET_INPUT: ret = get_input(cpu.ebx, cpu.ecx); break;
+		default: panic("unknown hypercall %d", cpu.eax);
+	}
+
+	cpu.eax = ret & 0xffffffff;
+	cpu.edx = ret >> 32;
+}
+
+void hypercall_report() {
+	if(nr_region == 0) { return; }
+
+	if(region_depth != 0) {
+		printf("nemu: %d profiling region(s) did not end\n", region_depth);
+	}
+	print_region_stats();
+}
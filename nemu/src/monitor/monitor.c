@@ -1,26 +1,81 @@
 #include "nemu.h"
 
+#include "monitor/monitor.h"
+#include "../../lib-common/trap.h"
+
+#include <stdlib.h>
+#include <getopt.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
 #define ENTRY_START 0x100000
+#define RAMDISK_SIZE 0xa0000
+#define PAGE_SIZE 4096
 
 extern uint8_t entry [];
 extern uint32_t entry_len;
 extern char *exec_file;
 
 void load_elf_tables(int, char *[]);
-void init_regex();
 void init_wp_pool();
+void init_snapshot();
 void init_ddr3();
+void set_jobs(int, char *[]);
+void hypercall_report();
+void profile_report();
+void opcode_stat_report();
+void trace_stop();
 
 FILE *log_fp = NULL;
 
+/* run the program without the user interface */
+bool batch_mode = false;
+
+extern bool fork_server_mode;
+extern char *input_file;
+extern int nr_job_thread;
+
+/* Parse the options, and return the index of the first non-option argument. */
+static int parse_args(int argc, char *argv[]) {
+	static const struct option options[] = {
+		{"batch", no_argument, NULL, 'b'},
+		{"input", required_argument, NULL, 'i'},
+		{"fork-server", no_argument, NULL, 'F'},
+		{"jobs", required_argument, NULL, 'j'},
+		{"huge-pages", required_argument, NULL, 'H'},
+		{0, 0, NULL, 0}
+	};
+	int opt;
+
+	while((opt = getopt_long(argc, argv, "+bi:j:", options, NULL)) != -1) {
+		switch(opt) {
+			case 'b': batch_mode = true; break;
+			case 'i': input_file = optarg; break;
+			case 'F': fork_server_mode = batch_mode = true; break;
+			case 'j': nr_job_thread = atoi(optarg); batch_mode = true; break;
+			case 'H':
+				if(strcmp(optarg, "thp") == 0) { dram_page_mode = DRAM_THP; break; }
+				if(strcmp(optarg, "hugetlb") == 0) { dram_page_mode = DRAM_HUGETLB; break; }
+				/* fall through */
+			default:
+				printf("Usage: %s [-b|--batch] [-i|--input FILE] [--fork-server] [--huge-pages thp|hugetlb] [program]\n"
+						"       %s -j|--jobs N [--huge-pages thp|hugetlb] program...\n", argv[0], argv[0]);
+				exit(1);
+		}
+	}
+	return optind;
+}
+
 static void init_log() {
 	log_fp = fopen("log.txt", "w");
 	Assert(log_fp, "Can not open 'log.txt'");
 }
 
 static void welcome() {
-	printf("Welcome to NEMU!\nThe executable is %s.\nFor help, type \"help\"\n",
-			exec_file);
+	printf("Welcome to NEMU!\nThe executable is %s.\n", exec_file);
+	if(!batch_mode) { printf("For help, type \"help\"\n"); }
 }
 
 void init_monitor(int argc, char *argv[]) {
@@ -29,64 +84,109 @@ void init_monitor(int argc, char *argv[]) {
 	/* Open the log file. */
 	init_log();
 
-	/* Load the string table and symbol table from the ELF file for future use. */
-	load_elf_tables(argc, argv);
+	/* Parse the options before the program. */
+	int idx = parse_args(argc, argv);
+
+	if(nr_job_thread > 0) {
+		/* Each program is loaded by the thread running it. */
+		set_jobs(argc - idx, argv + idx);
+		return;
+	}
 
-	/* Compile the regular expressions. */
-	init_regex();
+	/* Load the string table and symbol table from the ELF file for future use. */
+	load_elf_tables(argc - idx + 1, argv + idx - 1);
 
 	/* Initialize the watchpoint pool. */
 	init_wp_pool();
 
+	/* Register the CPU state to be saved into snapshots. */
+	init_snapshot();
+
 	/* Display welcome message. */
 	welcome();
 }
 
-#ifdef USE_RAMDISK
-static void init_ramdisk() {
-	int ret;
-	const int ramdisk_max_size = 0xa0000;
-	FILE *fp = fopen(exec_file, "rb");
-	Assert(fp, "Can not open '%s'", exec_file);
-
-	fseek(fp, 0, SEEK_END);
-	size_t file_size = ftell(fp);
-	Assert(file_size < ramdisk_max_size, "file size(%zd) too large", file_size);
-
-	fseek(fp, 0, SEEK_SET);
-	ret = fread(hwa_to_va(0), file_size, 1, fp);
-	assert(ret == 1);
-	fclose(fp);
-}
-#endif
+/* Return the exit status of NEMU, 0 only if the program hits the good trap. */
+int finish_monitor() {
+	/* Flush the instruction trace if it is being recorded. */
+	trace_stop();
+
+	/* Report the statistics of the profiling regions marked by the guest. */
+	hypercall_report();
 
-static void load_entry() {
-	int ret;
-	FILE *fp = fopen("entry", "rb");
-	Assert(fp, "Can not open 'entry'");
+	/* Write the profile of the guest if the profiler has been started. */
+	profile_report();
 
-	fseek(fp, 0, SEEK_END);
-	size_t file_size = ftell(fp);
+#ifdef OPCODE_STAT
+	/* Report the instructions retired for each opcode. */
+	opcode_stat_report();
+#endif
 
-	fseek(fp, 0, SEEK_SET);
-	ret = fread(hwa_to_va(ENTRY_START), file_size, 1, fp);
-	assert(ret == 1);
-	fclose(fp);
+	return (nemu_state == END && cpu.eax == NEMU_HC_GOOD_TRAP ? 0 : 1);
 }
 
-void restart() {
-	/* Perform some initialization to restart a program */
+/* Load the file into the physical memory at `addr', but not beyond
+ * `limit', and return its size. If `map' is true, the file is mapped
+ * copy-on-write when the memory allows, so only the pages touched by the
+ * guest are read. This must not be used if the file may be written while
+ * it is mapped, since the pages not written by the guest would change.
+ */
+static size_t load_file(const char *file, hwaddr_t addr, hwaddr_t limit, bool map) {
+	int fd = open(file, O_RDONLY);
+	Assert(fd != -1, "Can not open '%s'", file);
+
+	struct stat st;
+	int ret = fstat(fd, &st);
+	assert(ret == 0);
+	size_t file_size = st.st_size;
+	Assert(file_size <= limit - addr, "'%s' is too large (%zd bytes) to be loaded at 0x%x", file, file_size, addr);
+
+	void *p = hwa_to_va(addr);
+	size_t len = (file_size + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+	if(file_size > 0 && (!map || mmap(p, len, PROT_READ | PROT_WRITE, MAP_FIXED | MAP_PRIVATE, fd, 0) != p)) {
+		/* not to be mapped, or it can not be, e.g. the memory is backed by huge pages */
+		Assert(pread(fd, p, file_size, 0) == file_size, "Can not read '%s'", file);
+	}
+
+	close(fd);
+	return file_size;
+}
+
+/* Load the program `file' into the memory of the machine run by the
+ * current thread, and set the initial instruction pointer.
+ */
+void load_program(const char *file) {
 #ifdef USE_RAMDISK
-	/* Read the file with name `argv[1]' into ramdisk. */
-	init_ramdisk();
+	/* Map the file into ramdisk. It must not overlap the entry code. The
+	 * ramdisk driver of the kernel only sees the part below the video
+	 * memory at 0xa0000.
+	 */
+#ifdef HAS_DEVICE
+	/* The IDE disk is the same file, and it is opened for writing. */
+	bool map = false;
+#else
+	bool map = true;
+#endif
+	if(load_file(file, 0, ENTRY_START, map) > RAMDISK_SIZE) {
+		Log("'%s' is larger than the ramdisk seen by the kernel (%d KB)", file, RAMDISK_SIZE >> 10);
+	}
 #endif
 
-	/* Read the entry code into memory. */
-	load_entry();
+	/* Map the entry code into memory. */
+	load_file("entry", ENTRY_START, HW_MEM_SIZE, true);
 
 	/* Set the initial instruction pointer. */
 	cpu.eip = ENTRY_START;
 
+	/* Start with flat segments. */
+	reset_sregs();
+}
+
+void restart() {
+	/* Perform some initialization to restart a program */
+
 	/* Initialize DRAM. */
 	init_ddr3();
+
+	load_program(exec_file);
 }
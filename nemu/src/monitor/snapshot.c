@@ -0,0 +1,276 @@
+#include "nemu.h"
+#include "monitor/monitor.h"
+#include "monitor/snapshot.h"
+#include "monitor/checkpoint.h"
+
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+/* Snapshots of the whole machine. A snapshot file contains
+ *
+ *   SnapshotHeader
+ *   { StateHeader; uint8_t data[size]; } [nr_state]
+ *   uint8_t page_map[HW_MEM_SIZE / PAGE_SIZE / 8];   pages stored in the file
+ *   padding to PAGE_SIZE
+ *   the non-zero pages of the physical memory, in the order of addresses
+ *
+ * Zero pages are not stored. Loading a snapshot maps the stored pages
+ * into the physical memory copy-on-write, so that it costs time only for
+ * the pages actually touched by the guest. Do not modify a snapshot file
+ * while a snapshot loaded from it is in use. savevm() writes a new file
+ * and renames it over the old one, so saving into the file loaded last is
+ * fine: the mapped pages still refer to the old file.
+ */
+
+#define SNAPSHOT_MAGIC "NEMUSNP1"
+#define PAGE_SIZE 4096
+#define NR_PAGE (HW_MEM_SIZE / PAGE_SIZE)
+#define MAX_STATE 32
+
+typedef struct {
+	char magic[8];
+	uint32_t hw_mem_size;
+	uint32_t nr_state;
+	uint64_t data_offset;		/* where the pages begin */
+} SnapshotHeader;
+
+typedef struct {
+	char name[24];
+	uint32_t size;
+} StateHeader;
+
+static struct {
+	const char *name;
+	void *addr;
+	size_t size;
+} states[MAX_STATE];
+static int nr_state = 0;
+
+void tlb_flush();
+
+void snapshot_register(const char *name, void *addr, size_t size) {
+	int i;
+	assert(strlen(name) < sizeof(((StateHeader *)0)->name));
+	for(i = 0; i < nr_state && strcmp(states[i].name, name) != 0; i ++);
+	if(i == nr_state) {
+		assert(nr_state < MAX_STATE);
+		nr_state ++;
+	}
+	states[i].name = name;
+	states[i].addr = addr;
+	states[i].size = size;
+}
+
+void init_snapshot() {
+	snapshot_register("cpu", &cpu, sizeof(cpu));
+}
+
+size_t snapshot_state_size() {
+	size_t size = 0;
+	int i;
+	for(i = 0; i < nr_state; i ++) { size += states[i].size; }
+	return size;
+}
+
+void snapshot_save_state(void *buf) {
+	uint8_t *p = buf;
+	int i;
+	for(i = 0; i < nr_state; i ++) {
+		memcpy(p, states[i].addr, states[i].size);
+		p += states[i].size;
+	}
+}
+
+void snapshot_load_state(const void *buf) {
+	const uint8_t *p = buf;
+	int i;
+	for(i = 0; i < nr_state; i ++) {
+		memcpy(states[i].addr, p, states[i].size);
+		p += states[i].size;
+	}
+
+	/* The cached translations and rows may be stale now. */
+	tlb_flush();
+	invalidate_rowbufs();
+}
+
+static bool page_is_zero(const uint8_t *p) {
+	const uint64_t *q = (const void *)p;
+	int i;
+	for(i = 0; i < PAGE_SIZE / sizeof(uint64_t); i ++) {
+		if(q[i] != 0) { return false; }
+	}
+	return true;
+}
+
+static bool write_all(FILE *fp, const void *buf, size_t size) {
+	return size == 0 || fwrite(buf, size, 1, fp) == 1;
+}
+
+bool savevm(const char *filename) {
+	/* in the same directory, so that it can be renamed over `filename' */
+	char *tmp = malloc(strlen(filename) + 8);
+	assert(tmp);
+	sprintf(tmp, "%s.XXXXXX", filename);
+	int fd = mkstemp(tmp);
+	FILE *fp = (fd != -1 ? fdopen(fd, "wb") : NULL);
+	if(fp == NULL) {
+		printf("Can not create a file in the directory of '%s'\n", filename);
+		if(fd != -1) {
+			close(fd);
+			unlink(tmp);
+		}
+		free(tmp);
+		return false;
+	}
+
+	static uint8_t page_map[NR_PAGE / 8];
+	uint32_t i, nr_saved = 0;
+	bool ok = true;
+
+	/* Only look at the pages which have been touched. */
+	if(!dram_used_pages(page_map)) { memset(page_map, 0xff, sizeof(page_map)); }
+	for(i = 0; i < NR_PAGE; i ++) {
+		if(page_map[i / 8] & (1 << (i % 8))) {
+			if(page_is_zero(hw_mem + i * PAGE_SIZE)) { page_map[i / 8] &= ~(1 << (i % 8)); }
+			else { nr_saved ++; }
+		}
+	}
+
+	SnapshotHeader h;
+	memcpy(h.magic, SNAPSHOT_MAGIC, sizeof(h.magic));
+	h.hw_mem_size = HW_MEM_SIZE;
+	h.nr_state = nr_state;
+	h.data_offset = sizeof(h) + sizeof(page_map);
+	for(i = 0; i < nr_state; i ++) { h.data_offset += sizeof(StateHeader) + states[i].size; }
+	h.data_offset = (h.data_offset + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+
+	ok = ok && write_all(fp, &h, sizeof(h));
+	for(i = 0; i < nr_state; i ++) {
+		StateHeader sh;
+		memset(&sh, 0, sizeof(sh));
+		strcpy(sh.name, states[i].name);
+		sh.size = states[i].size;
+		ok = ok && write_all(fp, &sh, sizeof(sh));
+		ok = ok && write_all(fp, states[i].addr, states[i].size);
+	}
+	ok = ok && write_all(fp, page_map, sizeof(page_map));
+	ok = ok && fseek(fp, h.data_offset, SEEK_SET) == 0;
+
+	for(i = 0; ok && i < NR_PAGE; i ++) {
+		if(page_map[i / 8] & (1 << (i % 8))) {
+			ok = write_all(fp, hw_mem + i * PAGE_SIZE, PAGE_SIZE);
+		}
+	}
+
+	if(fclose(fp) != 0) { ok = false; }
+	ok = ok && rename(tmp, filename) == 0;
+	if(!ok) {
+		printf("Failed to write '%s'\n", filename);
+		unlink(tmp);
+		free(tmp);
+		return false;
+	}
+	free(tmp);
+
+	printf("Saved %u non-zero pages (%u KB) of the memory into '%s'\n",
+			nr_saved, nr_saved * (PAGE_SIZE / 1024), filename);
+	return true;
+}
+
+/* Map pages [start, end) of the physical memory, from the file if `fd'
+ * is not -1, otherwise as zero pages. The pages are copied instead if
+ * they can not be mapped, e.g. when the memory is backed by huge pages.
+ */
+static bool map_pages(uint32_t start, uint32_t end, int fd, off_t offset) {
+	void *addr = hw_mem + start * PAGE_SIZE;
+	size_t len = (end - start) * PAGE_SIZE;
+	void *ret;
+	if(fd == -1) {
+		ret = mmap(addr, len, PROT_READ | PROT_WRITE, MAP_FIXED | MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if(ret != addr) { memset(addr, 0, len); }
+		return true;
+	}
+
+	ret = mmap(addr, len, PROT_READ | PROT_WRITE, MAP_FIXED | MAP_PRIVATE, fd, offset);
+	return ret == addr || pread(fd, addr, len, offset) == len;
+}
+
+bool loadvm(const char *filename) {
+	int fd = open(filename, O_RDONLY);
+	if(fd == -1) {
+		printf("Can not open '%s'\n", filename);
+		return false;
+	}
+
+	off_t file_size = lseek(fd, 0, SEEK_END);
+	uint8_t *p = (file_size >= sizeof(SnapshotHeader) ?
+			mmap(NULL, file_size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED);
+	if(p == MAP_FAILED) {
+		printf("'%s' is not a snapshot of NEMU\n", filename);
+		close(fd);
+		return false;
+	}
+
+	SnapshotHeader *h = (void *)p;
+	uint8_t *end = p + file_size;
+	uint32_t i, j;
+	bool ok = false;
+
+	if(memcmp(h->magic, SNAPSHOT_MAGIC, sizeof(h->magic)) != 0 || h->hw_mem_size != HW_MEM_SIZE) {
+		printf("'%s' is not a snapshot of NEMU with %d MB memory\n", filename, HW_MEM_SIZE >> 20);
+		goto out;
+	}
+
+	/* Check the states before modifying any of them. */
+	uint8_t *q = p + sizeof(*h);
+	for(i = 0; i < h->nr_state; i ++) {
+		StateHeader *sh = (void *)q;
+		if(q + sizeof(*sh) > end || q + sizeof(*sh) + sh->size > end) { goto corrupt; }
+		for(j = 0; j < nr_state && strncmp(states[j].name, sh->name, sizeof(sh->name)) != 0; j ++);
+		if(j == nr_state || states[j].size != sh->size) {
+			printf("State '%.*s' in the snapshot does not match this NEMU\n", (int)sizeof(sh->name), sh->name);
+			goto out;
+		}
+		q += sizeof(*sh) + sh->size;
+	}
+	uint8_t *page_map = q;
+	if(page_map + NR_PAGE / 8 > end || h->data_offset % PAGE_SIZE != 0) { goto corrupt; }
+	uint64_t nr_stored = 0;
+	for(i = 0; i < NR_PAGE; i ++) { nr_stored += (page_map[i / 8] >> (i % 8)) & 1; }
+	if(h->data_offset + nr_stored * PAGE_SIZE > file_size) { goto corrupt; }
+
+	q = p + sizeof(*h);
+	for(i = 0; i < h->nr_state; i ++) {
+		StateHeader *sh = (void *)q;
+		for(j = 0; strncmp(states[j].name, sh->name, sizeof(sh->name)) != 0; j ++);
+		memcpy(states[j].addr, q + sizeof(*sh), sh->size);
+		q += sizeof(*sh) + sh->size;
+	}
+	tlb_flush();
+	invalidate_rowbufs();
+
+	/* Map runs of stored pages and runs of zero pages. */
+	off_t offset = h->data_offset;
+	for(i = 0; i < NR_PAGE; ) {
+		bool stored = (page_map[i / 8] >> (i % 8)) & 1;
+		for(j = i + 1; j < NR_PAGE && ((page_map[j / 8] >> (j % 8)) & 1) == stored; j ++);
+		Assert(map_pages(i, j, (stored ? fd : -1), offset), "failed to map the snapshot");
+		if(stored) { offset += (off_t)(j - i) * PAGE_SIZE; }
+		i = j;
+	}
+
+	nemu_state = STOP;
+	reset_checkpoints();
+	ok = true;
+	goto out;
+
+corrupt:
+	printf("'%s' is corrupted\n", filename);
+out:
+	munmap(p, file_size);
+	close(fd);
+	return ok;
+}
@@ -0,0 +1,198 @@
+#include "nemu.h"
+#include "cpu/helper.h"
+#include "monitor/trace.h"
+
+#include <stdlib.h>
+#include <pthread.h>
+#include <time.h>
+#include <sched.h>
+#include <zlib.h>
+
+/* The binary instruction trace. Records are appended to fixed-size
+ * blocks by cpu_exec(). A full block is handed to a background writer
+ * thread through a lock-free single-producer/single-consumer ring, and
+ * the writer thread compresses it into the trace file.
+ */
+
+#define BLOCK_SIZE (64 * 1024)
+#define NR_BLOCK 64
+
+typedef struct {
+	uint32_t size;
+	uint8_t buf[BLOCK_SIZE];
+} Block;
+
+static Block *blocks = NULL;
+
+/* Only the producer writes `nr_published', and only the writer thread
+ * writes `nr_consumed'. Block i lives in blocks[i % NR_BLOCK].
+ */
+static uint32_t nr_published, nr_consumed;
+static bool stopping;
+
+static pthread_t writer;
+static gzFile trace_fp;
+
+/* the block being filled by the producer */
+static Block *cur_block;
+
+bool trace_enabled = false;
+bool trace_mem_enabled = false;
+static bool trace_reg_enabled;
+static uint32_t last_gpr[8];
+static uint64_t nr_record;
+
+/* memory writes of the current instruction */
+static struct {
+	swaddr_t addr;
+	uint8_t len;
+	uint32_t data;
+} mem_writes[TRACE_MAX_MEM];
+static int nr_mem_write;
+static bool mem_write_trunc;
+
+static void* writer_main(void *arg) {
+	struct timespec ts = { .tv_sec = 0, .tv_nsec = 100000 };
+	while(1) {
+		uint32_t published = __atomic_load_n(&nr_published, __ATOMIC_ACQUIRE);
+		if(nr_consumed == published) {
+			if(__atomic_load_n(&stopping, __ATOMIC_ACQUIRE)) {
+				/* `stopping' is set after the last block is published */
+				if(nr_consumed == __atomic_load_n(&nr_published, __ATOMIC_ACQUIRE)) { break; }
+				continue;
+			}
+			nanosleep(&ts, NULL);
+			continue;
+		}
+
+		Block *b = &blocks[nr_consumed % NR_BLOCK];
+		int ret = gzwrite(trace_fp, b->buf, b->size);
+		Assert(ret == b->size, "failed to write the trace file");
+		__atomic_store_n(&nr_consumed, nr_consumed + 1, __ATOMIC_RELEASE);
+	}
+	return NULL;
+}
+
+static void acquire_block() {
+	/* wait for the writer thread if the ring is full */
+	while(nr_published - __atomic_load_n(&nr_consumed, __ATOMIC_ACQUIRE) == NR_BLOCK) {
+		sched_yield();
+	}
+	cur_block = &blocks[nr_published % NR_BLOCK];
+	cur_block->size = 0;
+}
+
+static void publish_block() {
+	__atomic_store_n(&nr_published, nr_published + 1, __ATOMIC_RELEASE);
+}
+
+void trace_start(const char *filename, bool reg, bool mem) {
+	assert(!trace_enabled);
+
+	trace_fp = gzopen(filename, "wb1");
+	Assert(trace_fp, "Can not open '%s'", filename);
+	int ret = gzwrite(trace_fp, TRACE_MAGIC, TRACE_MAGIC_LEN);
+	assert(ret == TRACE_MAGIC_LEN);
+
+	if(blocks == NULL) {
+		blocks = malloc(sizeof(Block) * NR_BLOCK);
+		assert(blocks);
+	}
+	nr_published = nr_consumed = 0;
+	stopping = false;
+	acquire_block();
+
+	ret = pthread_create(&writer, NULL, writer_main, NULL);
+	assert(ret == 0);
+
+	int i;
+	for(i = R_EAX; i <= R_EDI; i ++) { last_gpr[i] = reg_l(i); }
+
+	trace_reg_enabled = reg;
+	trace_mem_enabled = mem;
+	nr_mem_write = 0;
+	mem_write_trunc = false;
+	nr_record = 0;
+	trace_enabled = true;
+}
+
+void trace_stop() {
+	if(!trace_enabled) { return; }
+
+	if(cur_block->size != 0) { publish_block(); }
+	__atomic_store_n(&stopping, true, __ATOMIC_RELEASE);
+	pthread_join(writer, NULL);
+	gzclose(trace_fp);
+
+	trace_enabled = false;
+	trace_mem_enabled = false;
+	printf("nemu: %llu instructions are traced\n", (unsigned long long)nr_record);
+}
+
+/* Called by swaddr_write() when `trace_mem_enabled' is set. */
+void trace_mem_write(swaddr_t addr, size_t len, uint32_t data) {
+	if(nr_mem_write == TRACE_MAX_MEM) {
+		mem_write_trunc = true;
+		return;
+	}
+	mem_writes[nr_mem_write].addr = addr;
+	mem_writes[nr_mem_write].len = len;
+	mem_writes[nr_mem_write].data = data;
+	nr_mem_write ++;
+}
+
+#define emit(p, val, size) \
+	do { uint32_t __val = (val); memcpy(p, &__val, size); p += size; } while(0)
+
+/* Append a record for the instruction just executed. */
+void trace_instr(swaddr_t eip, int len) {
+	if(cur_block->size > BLOCK_SIZE - TRACE_MAX_RECORD_LEN) {
+		publish_block();
+		acquire_block();
+	}
+
+	uint8_t *p = cur_block->buf + cur_block->size;
+	uint8_t *flags = p;
+	int i;
+
+	if(len > TRACE_MAX_INSTR_LEN) { len = TRACE_MAX_INSTR_LEN; }
+
+	*flags = 0;
+	p ++;
+	emit(p, len, 1);
+	emit(p, eip, 4);
+	for(i = 0; i < len; i ++) {
+		emit(p, instr_fetch(eip + i, 1), 1);
+	}
+
+	if(trace_reg_enabled) {
+		uint8_t *mask = p ++;
+		*mask = 0;
+		for(i = R_EAX; i <= R_EDI; i ++) {
+			uint32_t val = reg_l(i);
+			if(val != last_gpr[i]) {
+				last_gpr[i] = val;
+				*mask |= 1 << i;
+				emit(p, val, 4);
+			}
+		}
+		if(*mask != 0) { *flags |= TRACE_REG; }
+		else { p --; }
+	}
+
+	if(nr_mem_write != 0) {
+		*flags |= TRACE_MEM;
+		if(mem_write_trunc) { *flags |= TRACE_MEM_TRUNC; }
+		emit(p, nr_mem_write, 1);
+		for(i = 0; i < nr_mem_write; i ++) {
+			emit(p, mem_writes[i].addr, 4);
+			emit(p, mem_writes[i].len, 1);
+			emit(p, mem_writes[i].data, 4);
+		}
+		nr_mem_write = 0;
+		mem_write_trunc = false;
+	}
+
+	cur_block->size = p - cur_block->buf;
+	nr_record ++;
+}
@@ -0,0 +1,171 @@
+/* Dump the binary instruction trace recorded by the `trace' command of NEMU.
+ *
+ * Usage: trace-dump [-d listing] [-s start] [-e end] [-f first] [-n count] trace-file
+ *   -d listing   annotate instructions with the output of `objdump -d'
+ *   -s/-e addr   only dump instructions with start <= eip < end
+ *   -f first     skip the first `first' instructions in the trace
+ *   -n count     dump at most `count' instructions
+ */
+
+#include "monitor/trace.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <zlib.h>
+
+static const char *regsl[] = {"eax", "ecx", "edx", "ebx", "esp", "ebp", "esi", "edi"};
+
+/* disassembly from the objdump listing, sorted by address */
+typedef struct {
+	uint32_t addr;
+	char *text;
+} Line;
+
+static Line *lines = NULL;
+static int nr_line = 0;
+
+static void load_listing(const char *filename) {
+	FILE *fp = fopen(filename, "r");
+	if(fp == NULL) {
+		fprintf(stderr, "Can not open '%s'\n", filename);
+		exit(1);
+	}
+
+	char buf[512];
+	int max_line = 1024;
+	lines = malloc(sizeof(Line) * max_line);
+
+	uint32_t last_addr = 0;
+	while(fgets(buf, sizeof(buf), fp) != NULL) {
+		/* "  100000:\tb8 00 00 00 00       \tmov    $0x0,%eax" */
+		char *colon, *tab;
+		uint32_t addr = strtoul(buf, &colon, 16);
+		if(colon == buf || *colon != ':' || colon[1] != '\t') { continue; }
+
+		/* the mnemonic is after the second tab */
+		tab = strchr(colon + 2, '\t');
+		if(tab == NULL) { continue; }
+		tab[strcspn(tab, "\n")] = '\0';
+
+		if(nr_line == max_line) {
+			max_line *= 2;
+			lines = realloc(lines, sizeof(Line) * max_line);
+		}
+		/* objdump lists addresses in increasing order within a section */
+		if(nr_line > 0 && addr < last_addr) {
+			fprintf(stderr, "warning: unsorted listing at 0x%x\n", addr);
+		}
+		lines[nr_line].addr = last_addr = addr;
+		lines[nr_line].text = strdup(tab + 1);
+		nr_line ++;
+	}
+	fclose(fp);
+}
+
+static const char* find_line(uint32_t addr) {
+	int l = 0, r = nr_line - 1;
+	while(l <= r) {
+		int mid = (l + r) / 2;
+		if(lines[mid].addr == addr) { return lines[mid].text; }
+		if(lines[mid].addr < addr) { l = mid + 1; }
+		else { r = mid - 1; }
+	}
+	return "";
+}
+
+static gzFile fp;
+
+static uint32_t read_field(int size) {
+	uint32_t val = 0;
+	if(gzread(fp, &val, size) != size) {
+		fprintf(stderr, "truncated trace file\n");
+		exit(1);
+	}
+	return val;
+}
+
+static void usage(const char *prog) {
+	fprintf(stderr, "Usage: %s [-d listing] [-s start] [-e end] [-f first] [-n count] trace-file\n", prog);
+	exit(1);
+}
+
+int main(int argc, char *argv[]) {
+	uint32_t start = 0, end = 0xffffffff;
+	unsigned long long first = 0, count = -1ull;
+	int opt;
+
+	while((opt = getopt(argc, argv, "d:s:e:f:n:")) != -1) {
+		switch(opt) {
+			case 'd': load_listing(optarg); break;
+			case 's': start = strtoul(optarg, NULL, 0); break;
+			case 'e': end = strtoul(optarg, NULL, 0); break;
+			case 'f': first = strtoull(optarg, NULL, 0); break;
+			case 'n': count = strtoull(optarg, NULL, 0); break;
+			default: usage(argv[0]);
+		}
+	}
+	if(optind + 1 != argc) { usage(argv[0]); }
+
+	fp = gzopen(argv[optind], "rb");
+	if(fp == NULL) {
+		fprintf(stderr, "Can not open '%s'\n", argv[optind]);
+		return 1;
+	}
+
+	char magic[TRACE_MAGIC_LEN];
+	if(gzread(fp, magic, TRACE_MAGIC_LEN) != TRACE_MAGIC_LEN ||
+			memcmp(magic, TRACE_MAGIC, TRACE_MAGIC_LEN) != 0) {
+		fprintf(stderr, "'%s' is not a trace file of NEMU\n", argv[optind]);
+		return 1;
+	}
+
+	unsigned long long idx;
+	int flags;
+	for(idx = 0; count != 0 && (flags = gzgetc(fp)) != -1; idx ++) {
+		char buf[1024];
+		int l = 0, i;
+
+		int len = read_field(1);
+		uint32_t eip = read_field(4);
+		uint8_t instr[TRACE_MAX_INSTR_LEN];
+		for(i = 0; i < len; i ++) { instr[i] = read_field(1); }
+
+		l += sprintf(buf + l, "%10llu %8x:   ", idx, eip);
+		for(i = 0; i < len; i ++) { l += sprintf(buf + l, "%02x ", instr[i]); }
+		l += sprintf(buf + l, "%*.s", 50 - (12 + 3 * len), "");
+		l += sprintf(buf + l, "%s", (nr_line != 0 ? find_line(eip) : ""));
+
+		if(flags & TRACE_REG) {
+			int mask = read_field(1);
+			for(i = 0; i < 8; i ++) {
+				if(mask & (1 << i)) {
+					uint32_t val = read_field(4);
+					l += sprintf(buf + l, "  %%%s=0x%x", regsl[i], val);
+				}
+			}
+		}
+
+		if(flags & TRACE_MEM) {
+			int nr = read_field(1);
+			for(i = 0; i < nr; i ++) {
+				uint32_t addr = read_field(4);
+				int size = read_field(1);
+				uint32_t data = read_field(4);
+				if(l < sizeof(buf) - 40) {
+					l += sprintf(buf + l, "  [0x%x]%d=0x%x", addr, size, data);
+				}
+			}
+			if(flags & TRACE_MEM_TRUNC) { l += sprintf(buf + l, "  ..."); }
+		}
+
+		if(idx >= first && eip >= start && eip < end) {
+			puts(buf);
+			count --;
+		}
+	}
+
+	gzclose(fp);
+	return 0;
+}
@@ -16,6 +16,9 @@ for file in $@; do
 		rm $logfile
 	else
 		echo -e "\033[1;31mFAIL!\033[0m see $logfile for more information"
+		# log.txt is off by default, run it again to write every instruction into it
+		rm -f log.txt
+		echo -e "log on\n$cmd" | $nemu $file &> /dev/null
 		if (test -e log.txt) then
 			echo -e "\n\n===== the original log.txt =====\n" >> $logfile
 			cat log.txt >> $logfile